@@ -0,0 +1,769 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/* Headless batch programmer: runs a job on a stream of units, using the
+ * devices and programmers configured with flP5, and reports the cycle
+ * time and failure statistics of the batch. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#ifndef WIN32
+#  include <unistd.h>
+#endif
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+#include "Util.h"
+#include "Preferences.h"
+#include "DataBuffer.h"
+#include "HexFile.h"
+#include "PatchTemplate.h"
+#include "DeviceDB.h"
+#include "DeviceSpec.h"
+#include "Device.h"
+#include "IO.h"
+
+/* A step of the job with the supply voltage to run it at */
+typedef struct {
+    JobStep step;
+    IO::VddMode vdd;
+    bool patch;         /* Reprogram on top of the base image */
+} CliStep;
+
+typedef vector<CliStep> CliStepVector;
+
+/* The outcome of a unit */
+typedef struct {
+    bool passed;
+    int failed_step;    /* Index in the job, -1 if none */
+    microtime_t usecs;
+} UnitResult;
+
+static const char *portAccess[] = { "DirectPP", "LinuxPPDev" };
+
+static const char *stepName[] = {
+    /* JOB_CHECK       */ "check",
+    /* JOB_ERASE       */ "erase",
+    /* JOB_BLANK_CHECK */ "blank",
+    /* JOB_PROGRAM     */ "program",
+    /* JOB_REPROGRAM   */ "reprogram",
+    /* JOB_VERIFY      */ "verify"
+};
+
+static IO *io = NULL;
+static volatile sig_atomic_t stopRequested = 0;
+
+static void sighandler(int sig)
+{
+    if (stopRequested) {
+        fprintf(stderr, "Caught signal %d.\n", sig);
+        if (io != NULL) {
+            delete io;
+            io = NULL;
+        }
+        exit(1);
+    }
+    /* Let the current unit complete, then print the statistics */
+    stopRequested = 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf (
+        stderr,
+        "Usage: %s -d device [-p programmer] [options] file\n"
+        "\n"
+        "  -d device      Device name, as configured in flP5\n"
+        "                 (e.g. PIC16F84A or Microchip/PIC/PIC16F84A)\n"
+        "  -p programmer  Programmer name, as configured in flP5\n"
+        "  -j job         Comma separated steps (default\n"
+        "                 erase,program,verify): check, erase, blank,\n"
+        "                 program, reprogram, patch,\n"
+        "                 verify[@prog|@min|@max]; a bare prog, min or max\n"
+        "                 after a verify adds a verify at that voltage\n"
+        "                 (verify@min,max); patch writes only the rows\n"
+        "                 changed by the patch slots, on units which\n"
+        "                 already hold the image\n"
+        "  -m method      Port access method: DirectPP or LinuxPPDev\n"
+        "  -P port        Parallel port number (0 = LPT1)\n"
+        "  -S slot        Patch slot, name:addr:width:format[:start[:step\n"
+        "                 [:bits[:fill]]]] with format le, be, bcd, dec or\n"
+        "                 hex; start may be @file to read a value per unit\n"
+        "                 (e.g. serial:0x2100:4:bcd:1000)\n"
+        "  -L file        Append the values injected in each unit to file\n"
+        "  -l file        Write the disassembly listing of the image to\n"
+        "                 file (- for stdout); without -p, nothing is\n"
+        "                 programmed\n"
+        "  -n count       Number of units to program, 0 = until stopped\n"
+        "                 (default 1)\n"
+        "  -w             Wait for Enter before each unit\n"
+        "  -x             Stop at the first failed unit\n"
+        "  -q             Only print the batch statistics\n",
+        prog
+    );
+}
+
+static bool parseVdd(const char *name, IO::VddMode& vdd)
+{
+    if (strcasecmp(name, "prog") == 0) {
+        vdd = IO::VDD_TO_PRG;
+    } else if (strcasecmp(name, "min") == 0) {
+        vdd = IO::VDD_TO_MIN;
+    } else if (strcasecmp(name, "max") == 0) {
+        vdd = IO::VDD_TO_MAX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static void parseJob(const char *job, CliStepVector& steps)
+{
+char spec[1024];
+char *token, *at;
+CliStep step;
+unsigned int i;
+
+    strncpy(spec, job, sizeof(spec) - 1);
+    spec[sizeof(spec) - 1] = '\0';
+    steps.clear();
+    for (token = strtok(spec, ","); token; token = strtok(NULL, ",")) {
+        step.vdd   = IO::VDD_TO_PRG;
+        step.patch = false;
+        if (
+            !steps.empty() &&
+            steps.back().step == JOB_VERIFY &&
+            parseVdd(token, step.vdd)
+        ) {
+            /* verify@min,max: another verify at the given voltage */
+            step.step = JOB_VERIFY;
+            steps.push_back(step);
+            continue;
+        }
+        if (strcasecmp(token, "patch") == 0) {
+            step.step  = JOB_REPROGRAM;
+            step.patch = true;
+            steps.push_back(step);
+            continue;
+        }
+        at = strchr(token, '@');
+        if (at) {
+            *at++ = '\0';
+        }
+        for (i=0; i<sizeof(stepName)/sizeof(stepName[0]); i++) {
+            if (strcasecmp(token, stepName[i]) == 0) {
+                break;
+            }
+        }
+        if (i == sizeof(stepName)/sizeof(stepName[0])) {
+            throw runtime_error (
+                (const char *)Preferences::Name("Unknown job step %s", token)
+            );
+        }
+        step.step = (JobStep)i;
+        if (at && (step.step != JOB_VERIFY || !parseVdd(at, step.vdd))) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Unknown voltage %s for %s",
+                    at,
+                    token
+                )
+            );
+        }
+        steps.push_back(step);
+    }
+    if (steps.empty()) {
+        throw runtime_error("Empty job.");
+    }
+}
+
+static const char *stepLabel(const CliStep& step)
+{
+    if (step.patch) {
+        return "patch";
+    } else if (step.step == JOB_VERIFY && step.vdd == IO::VDD_TO_MIN) {
+        return "verify@min";
+    } else if (step.step == JOB_VERIFY && step.vdd == IO::VDD_TO_MAX) {
+        return "verify@max";
+    }
+    return stepName[step.step];
+}
+
+/* Adds a patch slot given as name:addr:width:format[:start[:step[:bits
+ * [:fill]]]]. A start of @file reads the value of each unit from file. */
+static void parseSlot (
+    PatchTemplate& patches,
+    const char *spec,
+    vector<FILE *>& valueFiles
+) {
+static const char *formats[] = { "le", "be", "bcd", "dec", "hex" };
+char buf[1024];
+char *field[8];
+unsigned int n, format;
+FILE *fp = NULL;
+
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    field[0] = buf;
+    for (n=1; n<8 && (field[n] = strchr(field[n-1], ':')); n++) {
+        *field[n]++ = '\0';
+    }
+    for (format=0; n >= 4 && format<5; format++) {
+        if (strcasecmp(field[3], formats[format]) == 0) {
+            break;
+        }
+    }
+    if (n < 4 || format == 5) {
+        throw runtime_error (
+            (const char *)Preferences::Name("Invalid patch slot %s", spec)
+        );
+    }
+    if (n > 4 && field[4][0] == '@') {
+        fp = fopen(field[4] + 1, "r");
+        if (fp == NULL) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Can't open the values of patch slot %s",
+                    field[0]
+                )
+            );
+        }
+    }
+    patches.add_slot (
+        field[0],
+        strtoul(field[1], NULL, 0),
+        strtoul(field[2], NULL, 0),
+        (PatchFormat)format,
+        (n > 4 && !fp) ? strtoul(field[4], NULL, 0) : 0,
+        (n > 5 && !fp) ? strtol(field[5], NULL, 0) : (fp ? 0 : 1),
+        (n > 6) ? strtoul(field[6], NULL, 0) : 8,
+        (n > 7) ? strtoul(field[7], NULL, 0) : 0
+    );
+    valueFiles.push_back(fp);
+}
+
+/* Reads the next value of the slots which take them from a file.
+ * Returns false at the end of a file. */
+static bool readSlotValues (
+    PatchTemplate& patches,
+    vector<FILE *>& valueFiles
+) {
+char line[256];
+
+    for (unsigned int i=0; i<valueFiles.size(); i++) {
+        if (valueFiles[i] == NULL) {
+            continue;
+        }
+        do {
+            if (!fgets(line, sizeof(line), valueFiles[i])) {
+                return false;
+            }
+        } while (line[0] == '\n' || line[0] == '#');
+        patches.set_value(i, strtoul(line, NULL, 0));
+    }
+    return true;
+}
+
+/* Finds the full vendor/spec/device path of a device given by name only,
+ * through the compiled database when there is one */
+static bool findDevice (
+    Preferences& devices,
+    DeviceDB& db,
+    const char *name,
+    string& path
+) {
+int dev;
+
+    if (db.is_open() && (dev = db.find(name)) >= 0) {
+        path = db.get_path(dev);
+        return true;
+    }
+    if (strchr(name, '/')) {
+        path = name;
+        return devices.groupExists(name) != 0;
+    }
+    for (int vendor=0; vendor<devices.groups(); vendor++) {
+        Preferences vendors(devices, devices.group(vendor));
+        for (int spec=0; spec<vendors.groups(); spec++) {
+            Preferences specs(vendors, vendors.group(spec));
+            if (specs.groupExists(name)) {
+                path  = devices.group(vendor);
+                path += "/";
+                path += vendors.group(spec);
+                path += "/";
+                path += name;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* Runs the job on a unit. The steps at the same voltage in a row run in a
+ * single Device::run_job() session. The patch steps reprogram buf on top of
+ * base. */
+static void runUnit (
+    Device *chip,
+    DataBuffer& buf,
+    DataBuffer *base,
+    CliStepVector& steps,
+    UnitResult& result,
+    vector<microtime_t>& stepUsecs,
+    string& error
+) {
+JobStepVector group;
+JobTimingVector timings;
+size_t first, last, i;
+microtime_t start;
+
+    result.passed      = true;
+    result.failed_step = -1;
+    stepUsecs.assign(steps.size(), 0);
+    error = "";
+
+    io->gang_reset();
+    start = io->now();
+    for (first=0; first<steps.size(); first=last) {
+        group.clear();
+        for (
+            last = first;
+            last < steps.size() &&
+            steps[last].vdd   == steps[first].vdd &&
+            steps[last].patch == steps[first].patch;
+            last++
+        ) {
+            group.push_back(steps[last].step);
+        }
+        timings.clear();
+        try {
+            chip->set_job_base(steps[first].patch ? base : NULL);
+            io->vdd(steps[first].vdd);
+            chip->run_job(buf, group, timings);
+        } catch (std::exception& e) {
+            result.passed      = false;
+            result.failed_step = first + timings.size();
+            error = e.what();
+        }
+        for (i=0; i<timings.size(); i++) {
+            stepUsecs[first + i] = timings[i].usecs;
+        }
+        if (!result.passed) {
+            break;
+        }
+    }
+    io->vdd(IO::VDD_TO_PRG);
+    result.usecs = io->now() - start;
+
+    /* The bit-parallel targets are verified against the first one */
+    if (result.passed && io->gang_failed() != 0) {
+        result.passed = false;
+        error = (const char *)Preferences::Name (
+            "bit-parallel targets 0x%02x failed",
+            io->gang_failed()
+        );
+    }
+}
+
+static microtime_t percentile(vector<microtime_t>& sorted, int pct)
+{
+size_t rank;
+
+    /* Nearest rank */
+    rank = (sorted.size() * pct + 99) / 100;
+    if (rank > 0) {
+        rank--;
+    }
+    return sorted[rank];
+}
+
+static void printStatistics (
+    vector<UnitResult>& results,
+    CliStepVector& steps,
+    vector<unsigned long>& stepFailures
+) {
+vector<microtime_t> cycles;
+unsigned long passed = 0;
+double total = 0;
+size_t i;
+
+    for (i=0; i<results.size(); i++) {
+        cycles.push_back(results[i].usecs);
+        total += results[i].usecs;
+        if (results[i].passed) {
+            passed++;
+        }
+    }
+    printf (
+        "units: %lu, passed: %lu, failed: %lu\n",
+        (unsigned long)results.size(),
+        passed,
+        (unsigned long)(results.size() - passed)
+    );
+    if (cycles.empty()) {
+        return;
+    }
+    sort(cycles.begin(), cycles.end());
+    printf (
+        "cycle time (ms): min %.1f, mean %.1f, p50 %.1f, p90 %.1f, "
+        "p99 %.1f, max %.1f\n",
+        cycles.front() / 1000.0,
+        total / cycles.size() / 1000.0,
+        percentile(cycles, 50) / 1000.0,
+        percentile(cycles, 90) / 1000.0,
+        percentile(cycles, 99) / 1000.0,
+        cycles.back() / 1000.0
+    );
+    if (total > 0) {
+        printf("throughput: %.1f units/hour\n", 3600e6 * cycles.size() / total);
+    }
+    for (i=0; i<steps.size(); i++) {
+        if (stepFailures[i] > 0) {
+            printf (
+                "failures at %s: %lu\n",
+                stepLabel(steps[i]),
+                stepFailures[i]
+            );
+        }
+    }
+    if (stepFailures[steps.size()] > 0) {
+        printf (
+            "failures of the bit-parallel targets: %lu\n",
+            stepFailures[steps.size()]
+        );
+    }
+}
+
+static void closeFiles(vector<FILE *>& valueFiles, FILE *logFile)
+{
+    for (unsigned int i=0; i<valueFiles.size(); i++) {
+        if (valueFiles[i]) {
+            fclose(valueFiles[i]);
+        }
+    }
+    if (logFile) {
+        fclose(logFile);
+    }
+}
+
+int main(int argc, char **argv)
+{
+const char *deviceName = NULL, *programmerName = NULL, *job = NULL;
+const char *logName = NULL, *listName = NULL;
+char *hexName = NULL;
+char path[1024];
+int port = -1, method = -1, count = 1, opt, dev;
+bool waitUnit = false, stopOnFail = false, quiet = false;
+CliStepVector steps;
+Device *chip = NULL;
+HexFile *hf = NULL;
+vector<UnitResult> results;
+vector<unsigned long> stepFailures;
+vector<microtime_t> stepUsecs;
+UnitResult result;
+string devicePath, error;
+vector<const char *> slotSpecs;
+vector<FILE *> valueFiles;
+FILE *logFile = NULL, *listFile = NULL;
+bool needValues = true;
+char stamp[32];
+time_t t;
+size_t i;
+
+#ifndef WIN32
+    /* Set UID back to user if running setuid */
+    Util::setUser(getuid());
+#endif
+    Util::setProgramPath(argv[0]);
+
+    while ((opt = getopt(argc, argv, "d:p:j:m:P:n:S:L:l:wxqh")) != -1) {
+        switch (opt) {
+            case 'd': deviceName     = optarg;            break;
+            case 'p': programmerName = optarg;            break;
+            case 'j': job            = optarg;            break;
+            case 'P': port           = atoi(optarg);      break;
+            case 'n': count          = atoi(optarg);      break;
+            case 'S': slotSpecs.push_back(optarg);        break;
+            case 'L': logName        = optarg;            break;
+            case 'l': listName       = optarg;            break;
+            case 'w': waitUnit       = true;              break;
+            case 'x': stopOnFail     = true;              break;
+            case 'q': quiet          = true;              break;
+            case 'm':
+                for (method=1; method>=0; method--) {
+                    if (strcasecmp(optarg, portAccess[method]) == 0) {
+                        break;
+                    }
+                }
+                if (method < 0) {
+                    fprintf(stderr, "Unknown port access method %s\n", optarg);
+                    return 2;
+                }
+            break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (
+        !deviceName || (!programmerName && !listName) ||
+        optind != argc - 1 || count < 0
+    ) {
+        usage(argv[0]);
+        return 2;
+    }
+    hexName = argv[optind];
+
+    Preferences app(Preferences::USER, "flP5", "flP5");
+    Preferences programmers(Preferences::USER, "flP5", "programmers");
+    Preferences devices(Preferences::USER, "flP5", "devices");
+    DeviceDB db;
+
+    /* The port defaults to the one selected in flP5 */
+    if (port < 0) {
+        app.get("portNumber", port, 0);
+    }
+    if (method < 0) {
+        app.get("portAccessMethod", method, 0);
+    }
+
+    try {
+        parseJob(job ? job : "erase,program,verify", steps);
+
+        db.open_cached(devices);
+        if (!findDevice(devices, db, deviceName, devicePath)) {
+            throw runtime_error (
+                (const char *)Preferences::Name("Unknown device %s", deviceName)
+            );
+        }
+        if (programmerName && !programmers.groupExists(programmerName)) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Unknown programmer %s",
+                    programmerName
+                )
+            );
+        }
+        Preferences device(devices, devicePath.c_str());
+
+        /* With the database, the device settings are never parsed */
+        if (db.is_open() && (dev = db.find(devicePath.c_str())) >= 0) {
+            DeviceSpec::lookup(db, dev);
+        }
+        strncpy(path, devicePath.c_str(), sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+        chip = Device::load(&device, path);
+
+        /* The image shared by all the units, and the copy patched for
+         * each of them */
+        DataBuffer base(chip->get_wordsize());
+        hf = HexFile::load(hexName);
+        hf->read(base);
+        delete hf;
+        hf = NULL;
+
+        if (listName) {
+            if (strcmp(listName, "-") == 0) {
+                chip->write_listing(base, stdout);
+            } else {
+                listFile = fopen(listName, "w");
+                if (listFile == NULL) {
+                    throw runtime_error (
+                        (const char *)Preferences::Name (
+                            "Can't open %s",
+                            listName
+                        )
+                    );
+                }
+                chip->write_listing(base, listFile);
+                fclose(listFile);
+                listFile = NULL;
+            }
+            if (!programmerName) {
+                delete chip;
+                return 0;
+            }
+        }
+
+        DataBuffer buf(base);
+        PatchTemplate patches(base);
+
+        for (i=0; i<slotSpecs.size(); i++) {
+            parseSlot(patches, slotSpecs[i], valueFiles);
+        }
+        if (logName) {
+            logFile = fopen(logName, "a");
+            if (logFile == NULL) {
+                throw runtime_error (
+                    (const char *)Preferences::Name("Can't open %s", logName)
+                );
+            }
+        }
+
+        Preferences programmer(programmers, programmerName);
+        io = IO::acquire(&programmer, (char *)portAccess[method], port);
+        chip->set_iodevice(io);
+
+#ifndef WIN32
+        signal(SIGHUP , sighandler);
+        signal(SIGINT , sighandler);
+        signal(SIGQUIT, sighandler);
+        signal(SIGPIPE, sighandler);
+        signal(SIGTERM, sighandler);
+#endif
+
+        /* The last counter is for the bit-parallel targets */
+        stepFailures.assign(steps.size() + 1, 0);
+        for (
+            unsigned long unit = 1;
+            !stopRequested && (count == 0 || unit <= (unsigned long)count);
+            unit++
+        ) {
+            if (waitUnit) {
+                fprintf (
+                    stderr,
+                    "Insert unit %lu and press Enter (q to stop): ",
+                    unit
+                );
+                if (
+                    !fgets(path, sizeof(path), stdin) ||
+                    path[0] == 'q' || path[0] == 'Q'
+                ) {
+                    break;
+                }
+            }
+            if (patches.get_slots() > 0) {
+                try {
+                    if (needValues && !readSlotValues(patches, valueFiles)) {
+                        fprintf(stderr, "No more patch slot values\n");
+                        break;
+                    }
+                    patches.apply(buf);
+                } catch (std::exception& e) {
+                    fprintf(stderr, "%s\n", e.what());
+                    break;
+                }
+            }
+            runUnit(chip, buf, &base, steps, result, stepUsecs, error);
+            results.push_back(result);
+            if (logFile) {
+                t = time(NULL);
+                strftime (
+                    stamp,
+                    sizeof(stamp),
+                    "%Y-%m-%d %H:%M:%S",
+                    localtime(&t)
+                );
+                fprintf (
+                    logFile,
+                    "%s unit %lu %s %s%s%s\n",
+                    stamp,
+                    unit,
+                    result.passed ? "PASS" : "FAIL",
+                    patches.describe().c_str(),
+                    result.passed ? "" : " ",
+                    error.c_str()
+                );
+                fflush(logFile);
+            }
+            /* A failed unit doesn't use up its values */
+            needValues = result.passed;
+            if (result.passed) {
+                patches.next();
+            }
+            if (!result.passed) {
+                if (result.failed_step >= 0) {
+                    stepFailures[result.failed_step]++;
+                } else {
+                    stepFailures[steps.size()]++;
+                }
+            }
+            if (!quiet) {
+                printf (
+                    "unit %lu: %s %.1f ms (",
+                    unit,
+                    result.passed ? "PASS" : "FAIL",
+                    result.usecs / 1000.0
+                );
+                for (i=0; i<steps.size(); i++) {
+                    printf (
+                        "%s%s %.1f",
+                        (i > 0) ? ", " : "",
+                        stepLabel(steps[i]),
+                        stepUsecs[i] / 1000.0
+                    );
+                }
+                printf(")\n");
+                if (patches.get_slots() > 0) {
+                    printf("unit %lu: %s\n", unit, patches.describe().c_str());
+                }
+                if (!result.passed) {
+                    printf (
+                        "unit %lu: %s%s%s\n",
+                        unit,
+                        (result.failed_step >= 0)
+                            ? stepLabel(steps[result.failed_step]) : "",
+                        (result.failed_step >= 0) ? ": " : "",
+                        error.c_str()
+                    );
+                }
+                fflush(stdout);
+            }
+            if (!result.passed && stopOnFail) {
+                break;
+            }
+        }
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        closeFiles(valueFiles, logFile);
+        if (listFile) {
+            fclose(listFile);
+        }
+        if (hf) {
+            delete hf;
+        }
+        if (chip) {
+            delete chip;
+        }
+        if (io) {
+            delete io;
+            io = NULL;
+        }
+        return 2;
+    }
+
+    printStatistics(results, steps, stepFailures);
+    closeFiles(valueFiles, logFile);
+
+    delete chip;
+    delete io;
+    io = NULL;
+
+    for (i=0; i<results.size(); i++) {
+        if (!results[i].passed) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <string.h>
+#include <stdio.h>
+#include <FL/Fl.H>
+#include <FL/fl_draw.H>
+#include <FL/Fl_Memory_View.H>
+
+Fl_Memory_View::Fl_Memory_View(int X,int Y,int W,int H,const char *L)
+: Fl_Browser_(X,Y,W,H,L)
+{
+    chip_ = 0;
+    buf_  = 0;
+}
+
+void Fl_Memory_View::view(Device *chip, DataBuffer *buf)
+{
+    chip_ = chip;
+    buf_  = buf;
+    rows_.clear();
+    if (chip_ && buf_) {
+        chip_->dump_rows(*buf_, rows_);
+    }
+    new_list();
+    redraw();
+}
+
+void Fl_Memory_View::clear()
+{
+    view(0, 0);
+}
+
+void *Fl_Memory_View::item_first() const
+{
+    return (rows_.size() > 0) ? (void *)1 : (void *)0;
+}
+
+void *Fl_Memory_View::item_next(void *v) const
+{
+    return ((size_t)v < rows_.size()) ? (void *)((size_t)v + 1) : (void *)0;
+}
+
+void *Fl_Memory_View::item_prev(void *v) const
+{
+    return ((size_t)v > 1) ? (void *)((size_t)v - 1) : (void *)0;
+}
+
+/* All the rows have the same height, so the browser can scroll to any of
+ * them without measuring the others */
+int Fl_Memory_View::item_height(void *) const
+{
+    return textsize() + 2;
+}
+
+int Fl_Memory_View::item_quick_height(void *v) const
+{
+    return item_height(v);
+}
+
+int Fl_Memory_View::incr_height() const
+{
+    return textsize() + 2;
+}
+
+int Fl_Memory_View::full_height() const
+{
+    return rows_.size() * incr_height();
+}
+
+void Fl_Memory_View::render(void *v, char *line, size_t size) const
+{
+    chip_->dump_row(*buf_, row(v), line, size);
+}
+
+int Fl_Memory_View::item_width(void *v) const
+{
+char line[256];
+
+    if (!v) {
+        return 0;
+    }
+    switch (row(v).kind) {
+        case DUMP_TITLE:
+            fl_font(textfont()|FL_BOLD, textsize());
+        break;
+        case DUMP_CODE:
+        case DUMP_OPERAND:
+        case DUMP_DATA:
+            fl_font(textfont(), textsize());
+        break;
+        default:
+            return 0;
+    }
+    render(v, line, sizeof(line));
+    return (int)fl_width(line) + 6;
+}
+
+void Fl_Memory_View::item_draw(void *v, int X, int Y, int W, int H) const
+{
+char line[256];
+int baseline;
+
+    if (!v) {
+        return;
+    }
+    fl_color(textcolor());
+    switch (row(v).kind) {
+        case DUMP_RULE:
+            fl_xyline(X + 3, Y + H/2, X + W - 6);
+        break;
+        case DUMP_TITLE:
+            render(v, line, sizeof(line));
+            fl_font(textfont()|FL_BOLD, textsize());
+            baseline = Y + H - fl_descent();
+            fl_draw(line, X + 3, baseline);
+            fl_xyline(X + 3, baseline + 1, X + 3 + (int)fl_width(line));
+        break;
+        case DUMP_CODE:
+        case DUMP_OPERAND:
+        case DUMP_DATA:
+            render(v, line, sizeof(line));
+            fl_font(textfont(), textsize());
+            fl_draw(line, X + 3, Y + H - fl_descent());
+        break;
+        default:
+        break;
+    }
+}
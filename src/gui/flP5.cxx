@@ -2314,7 +2314,7 @@ static void cb_ch_programmers(Fl_Sorted_Choice* o, void*) {
 mb_menuBar->redraw();
 }
 
-Fl_Browser *ls_memdump=(Fl_Browser *)0;
+Fl_Memory_View *ls_memdump=(Fl_Memory_View *)0;
 
 Fl_Pack *p_toolbar=(Fl_Pack *)0;
 
@@ -6217,7 +6217,7 @@ r must control the ICSP Vdd and the ICSP Vpp independently from each other.");
       }
       o->end();
     }
-    { Fl_Browser* o = ls_memdump = new Fl_Browser(35, 50, 325, 365);
+    { Fl_Memory_View* o = ls_memdump = new Fl_Memory_View(35, 50, 325, 365);
       o->textfont(4);
       o->textsize(12);
       o->has_scrollbar(Fl_Browser_::BOTH_ALWAYS);
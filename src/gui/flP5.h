@@ -77,8 +77,8 @@ extern Fl_Group *g_prop_delays;
 extern Fl_Progress *p_progress;
 extern Fl_Sorted_Choice *ch_devices;
 extern Fl_Sorted_Choice *ch_programmers;
-#include <FL/Fl_Browser.H>
-extern Fl_Browser *ls_memdump;
+#include <FL/Fl_Memory_View.H>
+extern Fl_Memory_View *ls_memdump;
 #include <FL/Fl_Pack.H>
 extern Fl_Pack *p_toolbar;
 extern Fl_RaiseButton *pb_operation[8];
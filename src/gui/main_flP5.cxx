@@ -41,7 +41,8 @@ using namespace std;
 #include "ParallelPort.h"
 
 DataBuffer buf(16);
-HexFile *hexFile = NULL;
+HexCache hexCache;
+GangProgrammer gang;
 Device *chip = NULL;
 IO *io = NULL;
 
@@ -658,6 +659,7 @@ char path[FL_PATH_MAX];
         ) {
             ((Fl_Menu_Item*)mitem)->labelcolor(FL_BLACK);
             devices.deleteGroup((const char *)mdata);
+            DeviceSpec::forget((const char *)mdata);
             ch_devices->remove(ch_devices->value());
             if (
                 ch_devices->value() &&
@@ -762,6 +764,7 @@ char path[FL_PATH_MAX];
                  }
             }
             if (chip) {
+                ls_memdump->clear();
                 delete chip;
                 chip = NULL;
             }
@@ -772,9 +775,6 @@ char path[FL_PATH_MAX];
                 chip = NULL;
                 return false;
             }
-            if (chip) {
-                chip->set_dump_cb(showMemoryDumpCB);
-            }
         } else {
             return false;
         }
@@ -794,11 +794,12 @@ char path[FL_PATH_MAX];
         )
     ) {
         ch_devices->sort();
-
+        DeviceSpec::forget();
     } else if (oper==CFG_SAVE && verifyDeviceConfig(true)) {
         mitem = ch_devProgSpec->mvalue();
         mdata = (char *)mitem->user_data();
         sprintf(buf,"%s/%s",mdata,tx_devName->value());
+        DeviceSpec::forget(buf);
         if (lastOper==CFG_EDIT) {
             ch_devices->replace(ch_devices->value(),tx_devName->value());
             if ((mitem = ch_devices->mvalue())) {
@@ -1724,53 +1725,49 @@ static CfgOper lastOper=CFG_NEW;
     return ok;
 }
 
-bool showMemoryDumpCB(void *data,const char *line,int progress)
-{
-    if (line) {
-        ls_memdump->add(line);
-    } else {
-        ls_memdump->clear();
-    }
-    return true;
-}
-
 void dumpHexFile(bool set_wordsize=false)
 {
     if (chip) {
         if (set_wordsize) {
             buf.set_wordsize(chip->get_wordsize());
         }
-        chip->dump(buf);
+        ls_memdump->view(chip, &buf);
     }
 }
 
+/* The state of a progress bar driven by a device progress callback */
+typedef struct {
+    int last_percent;
+    char msg[256];
+    char oper[256];
+#ifdef WIN32
+    LARGE_INTEGER last, start;
+#else
+    struct timeval last, start;
+#endif
+    double freq;
+} ProgressState;
+
+static ProgressState mainProgress = { -1, "", "" };
+
 static bool progressOperation(void *data, long addr, int percent)
 {
-static int last_percent = -1;
-static char msg[256];
-static char oper[256];
+ProgressState *state = (ProgressState *)data;
 
 #ifdef WIN32
-  static LARGE_INTEGER last, start;
   LARGE_INTEGER now;
 #else
-  static struct timeval last, start;
   struct timeval now;
 #endif
 
-static double freq = 1000000.0;
-
 double remaining, elaphsed, estimated;
 int rmin, emin, smin;
 double rsec, esec, ssec;
 
 
     if  (percent<0) {
-        oper[0] = '\0';
-        if (data) {
-            strcpy(oper,(char*)data);
-        }
-        last_percent = 101;
+        state->last_percent = 101;
+        state->freq = 1000000.0;
         p_progress->label("");
         p_progress->value(0);
         p_progress->minimum(0);
@@ -1778,35 +1775,35 @@ double rsec, esec, ssec;
         flP5->redraw();
         Fl::flush();
 #ifdef WIN32
-        if (QueryPerformanceFrequency(&start)) {
-            freq = (double)start.QuadPart / 2.0; // circa ;-<
+        if (QueryPerformanceFrequency(&state->start)) {
+            state->freq = (double)state->start.QuadPart / 2.0; // circa ;-<
         }
-        QueryPerformanceCounter(&last);
+        QueryPerformanceCounter(&state->last);
 #else
-        gettimeofday(&last,NULL);
+        gettimeofday(&state->last,NULL);
 #endif
-        start = last;
+        state->start = state->last;
     } else {
-        if (percent<=100 && percent != last_percent) {
+        if (percent<=100 && percent != state->last_percent) {
 #ifdef WIN32
             QueryPerformanceCounter(&now);
-            elaphsed  = fabs( (double)(now.QuadPart - start.QuadPart) );
-            remaining = fabs( (double)(now.QuadPart - last.QuadPart) );
+            elaphsed  = fabs( (double)(now.QuadPart - state->start.QuadPart) );
+            remaining = fabs( (double)(now.QuadPart - state->last.QuadPart) );
 #else
             gettimeofday(&now, NULL);
-            elaphsed  = fabs( (long double)(now.tv_usec - start.tv_usec) );
-            remaining = fabs( (long double)(now.tv_usec - last.tv_usec) );
+            elaphsed  = fabs( (long double)(now.tv_usec - state->start.tv_usec) );
+            remaining = fabs( (long double)(now.tv_usec - state->last.tv_usec) );
 #endif
-            if (percent>last_percent) {
-                remaining /= (double)(percent-last_percent);
+            if (percent>state->last_percent) {
+                remaining /= (double)(percent-state->last_percent);
             }
-            remaining /= (double)freq;
+            remaining /= (double)state->freq;
 
             remaining *= (double)(100 - percent);
             rmin = abs( (int)( remaining / 60 ) );
             rsec = fabs( (long double)( remaining - (double)( rmin * 60 ) ) );
 
-            elaphsed  /= (double)freq;
+            elaphsed  /= (double)state->freq;
             emin = abs( (int)( elaphsed / 60 ) );
             esec = fabs( (long double)( elaphsed - (double)( emin * 60 ) ) );
 
@@ -1815,32 +1812,250 @@ double rsec, esec, ssec;
             ssec = fabs( (long double)( estimated - (double)( smin * 60 ) ) );
 
             sprintf (
-                msg,
+                state->msg,
                 // " Address: 0x%06lx, %3d%% done",
                 // " %s: [%3d%%] %2d'%2d\" /%2d'%2d\" -%2d'%2d\"",
                 // " %s: [%3d%%] %2d'%4.1lf\" /%2d'%4.1lf\"",
                 " %s: [%3d%%]",
-                oper,
+                state->oper,
                 percent //,
                 // rmin, rsec,
                 // smin, ssec //,
                 // rmin, rsec
             );
-            p_progress->label(msg);
+            p_progress->label(state->msg);
             p_progress->value(percent);
             p_progress->redraw();
             Fl::flush();
-            last_percent = percent;
-            last = now;
+            state->last_percent = percent;
+            state->last = now;
         }
     }
     return true;
 }
 
+/* Restarts a progress bar for a new operation, named by oper (or unnamed
+ * if NULL) */
+static void startProgress(ProgressState *state, const char *oper)
+{
+    state->oper[0] = '\0';
+    if (oper) {
+        strncat(state->oper, oper, sizeof(state->oper) - 1);
+    }
+    progressOperation(state, 0, -1);
+}
+
+/* Shows the first mismatches found by a verify pass and, if asked, lets
+ * the user choose to repair them. Returns true if a repair was chosen. */
+static bool reportMismatches(int pass, MismatchVector& mismatches, bool ask)
+{
+static const char *title[] = {
+    "Verify @@ VDD prog.",
+    "Verify @@ VDD min.",
+    "Verify @@ VDD max."
+};
+char msg[1024];
+size_t len;
+unsigned int shown;
+MismatchVector::iterator n;
+
+    len = sprintf (
+        msg,
+        "%s\n\n%lu location(s) failed:\n",
+        title[pass],
+        (unsigned long)mismatches.size()
+    );
+    for (
+        n = mismatches.begin(), shown = 0;
+        n != mismatches.end() && shown < 8;
+        n++, shown++
+    ) {
+        len += sprintf (
+            msg + len,
+            "\n0x%06lx: wanted 0x%04x, got 0x%04x",
+            n->addr,
+            n->expected,
+            n->actual
+        );
+    }
+    if (shown < mismatches.size()) {
+        sprintf(msg + len, "\n...");
+    }
+    if (!ask) {
+        fl_message("%s", msg);
+        return false;
+    }
+    return fl_choice("%s", "Close", "Repair", NULL, msg) == 1;
+}
+
+/* Runs a write job on a device per parallel port listed in the gangPorts
+ * bitmask, in parallel, and reports the result of each slot. The port of
+ * the main programmer is released while the job runs. */
+static bool runGangJob(int gangPorts, JobStepVector& steps, char *report)
+{
+static const char *stateName[] = {
+    /* SLOT_IDLE    */ "idle",
+    /* SLOT_RUNNING */ "running",
+    /* SLOT_PASSED  */ "passed",
+    /* SLOT_FAILED  */ "FAILED"
+};
+static char label[256];
+const Fl_Menu_Item *mitem;
+char *mdata;
+char msg[2048];
+size_t len;
+int portNumber, portAccessMethod, percent, minPercent;
+int trustErase, trustEraseCheck;
+bool passed;
+
+    if (
+        !(mitem = ch_devices->mvalue()) ||
+        !(mdata = (char *)mitem->user_data())
+    ) {
+        return false;
+    }
+    Preferences device(devices,(const char *)mdata);
+    Preferences programmer(programmers,ch_programmers->text());
+
+    app.get("portNumber",portNumber,0);
+    app.get("portAccessMethod",portAccessMethod,0);
+    app.get("trustErase",trustErase,0);
+    app.get("trustEraseCheck",trustEraseCheck,0);
+
+    if (io) {
+        delete io;
+        io = NULL;
+    }
+    gang.clear();
+    try {
+        for (int port=0; port<MAX_LPTPORTS; port++) {
+            if (gangPorts & (1 << port)) {
+                gang.add_slot (
+                    &programmer,
+                    portAccess[portAccessMethod],
+                    port,
+                    &device,
+                    mdata
+                );
+            }
+        }
+        for (unsigned int i=0; i<gang.get_slots(); i++) {
+            gang.get_device(i)->set_trust_erase (
+                trustErase!=0,
+                trustEraseCheck!=0
+            );
+        }
+        gang.start(buf, steps);
+    } catch (std::exception& e) {
+        fl_alert("Gang: %s", e.what());
+    }
+
+    /* Show the progress of the slowest slot, and of each one */
+    while (gang.running()) {
+        len = sprintf(label, " Gang:");
+        minPercent = 100;
+        for (unsigned int i=0; i<gang.get_slots(); i++) {
+            percent = gang.get_progress(i);
+            if (percent < minPercent) {
+                minPercent = percent;
+            }
+            len += sprintf (
+                label + len,
+                " LPT%d %3d%%",
+                gang.get_port(i) + 1,
+                percent
+            );
+        }
+        p_progress->label(label);
+        p_progress->value(minPercent);
+        p_progress->redraw();
+        Fl::wait(0.1);
+    }
+    passed = gang.wait() && (gang.get_slots() > 0);
+
+    len = sprintf (
+        msg,
+        "%s on %u device(s) in %.2lfs\n",
+        passed ? "Write passed" : "Write failed",
+        gang.get_slots(),
+        gang.get_elapsed() / 1000000.0
+    );
+    for (
+        unsigned int i=0;
+        i<gang.get_slots() && len < sizeof(msg)-256;
+        i++
+    ) {
+        len += sprintf (
+            msg + len,
+            "\nLPT%d: %s %.200s",
+            gang.get_port(i) + 1,
+            stateName[gang.get_state(i)],
+            gang.get_error(i)
+        );
+    }
+    sprintf (
+        report,
+        " Gang write: %u device(s), %s, %.2lfs",
+        gang.get_slots(),
+        passed ? "passed" : "failed",
+        gang.get_elapsed() / 1000000.0
+    );
+    fl_message("%s", msg);
+
+    /* Give the main programmer its port back */
+    gang.clear();
+    try {
+        io = IO::acquire (
+            &programmer,
+            portAccess[portAccessMethod],
+            portNumber
+        );
+        chip->set_iodevice(io);
+    } catch (std::exception& e) {
+        fl_alert("I/O init: %s", e.what());
+        io = NULL;
+    }
+    return passed;
+}
+
+/* Appends the list of the bit-parallel gang targets which failed to a
+ * report. Returns the new length of the report. */
+static size_t gangTargetsReport(char *report, size_t len, size_t size)
+{
+uint32_t failed = io->gang_failed();
+int targets = io->gang_targets();
+
+    if (targets <= 1 || len >= size-64) {
+        return len;
+    }
+    if (failed == 0) {
+        return len + sprintf(report + len, " - %d targets passed", targets);
+    }
+    len += sprintf(report + len, " - failed targets:");
+    for (int t=0; t<targets; t++) {
+        if (failed & (1 << t)) {
+            len += sprintf(report + len, " %d", t+1);
+        }
+    }
+    return len;
+}
+
 bool processOperation(ChipOper oper)
 {
 static int lastDevice=-1;
 static int lastProgrammer=-1;
+static DataBuffer lastWritten(16);
+static int lastWrittenDevice=-1;
+static char cellReport[256];
+static int erasedDevice=-1;
+static const char *jobStepName[] = {
+    /* JOB_CHECK       */ "check",
+    /* JOB_ERASE       */ "erase",
+    /* JOB_BLANK_CHECK */ "blank check",
+    /* JOB_PROGRAM     */ "program",
+    /* JOB_REPROGRAM   */ "reprogram",
+    /* JOB_VERIFY      */ "verify"
+};
 double vppMin, vppMax;
 double vddMin, vddMax;
 double vddpMin, vddpMax;
@@ -1915,6 +2130,10 @@ char *soper[] = {
             if (!proceed) {
                 return false;
             }
+            if (forceCalibration) {
+                /* Another device (or programmer): forget its erase */
+                erasedDevice = -1;
+            }
             lastDevice     = currentDevice;
             lastProgrammer = currentProgrammer;
         
@@ -1922,24 +2141,29 @@ char *soper[] = {
                 io->vdd(IO::VDD_TO_PRG);
             }
             chip->set_iodevice(io);
-            chip->set_progress_cb(progressOperation);
+            chip->set_progress_cb(progressOperation, &mainProgress);
 
             // init progress bar & time remaining calculations
-            progressOperation((void*)soper[oper],0,-1);
+            startProgress(&mainProgress, soper[oper]);
         
             switch (oper) {
                 case CHIP_READ:
+                    /* Maybe a new device is in the socket */
+                    erasedDevice = -1;
                     buf.set_wordsize(chip->get_wordsize());
                     try {
                         chip->read(buf);
                     } catch(std::exception& e) {
                         fl_alert("%s: %s",chip->get_name().c_str(),e.what());
                     }
-                    chip->dump(buf);
+                    dumpHexFile();
                 break;
                 case CHIP_ERASE:
+                    lastWrittenDevice = -1;
+                    erasedDevice = -1;
                     try {
                         chip->erase();
+                        erasedDevice = currentDevice;
                     } catch(std::exception& e) {
                         fl_alert("%s: %s",chip->get_name().c_str(),e.what());
                     }
@@ -1947,33 +2171,178 @@ char *soper[] = {
                 case CHIP_BLANCK_CHECK: {
                     DataBuffer lbuf(chip->get_wordsize());
                     chip->set_config_default(lbuf);
+                    io->gang_read(IO::GANG_READ_VERIFY);
                     try {
                         chip->read(lbuf,true);
                     } catch(std::exception& e) {
+                        io->gang_read(IO::GANG_READ_FIRST);
                         fl_message("%s\nDevice is not blank.",e.what());
-                        progressOperation((void*)0,0,-1);
+                        startProgress(&mainProgress, NULL);
                         return false;
                     }
+                    io->gang_read(IO::GANG_READ_FIRST);
                     fl_message("Device is blank.");
                 } break;
-                case CHIP_WRITE:
+                case CHIP_WRITE: {
+                    int trustErase, trustEraseCheck, incrementalWrite;
+                    int singleSession, gangPorts;
+                    unsigned long cellsWritten, cellsSkipped;
+                    JobStepVector steps;
+                    JobTimingVector timings;
+                    size_t len;
+
+                    cellReport[0] = '\0';
+
+                    /* Only an erase and write session leaves the blank
+                     * locations erased */
+                    erasedDevice = -1;
+
+                    /* Skip the blank locations just erased, if enabled */
+                    app.get("trustErase",trustErase,0);
+                    app.get("trustEraseCheck",trustEraseCheck,0);
+                    chip->set_trust_erase(trustErase!=0,trustEraseCheck!=0);
+
+                    /* Incremental write: 0 = off, 1 = compare with the
+                     * device contents, 2 = compare with the image written
+                     * last time (the device must not have been replaced) */
+                    app.get("incrementalWrite",incrementalWrite,0);
+
+                    /* Single session: erase (unless incremental), write
+                     * and verify without leaving program mode, if the
+                     * device allows it */
+                    app.get("singleSession",singleSession,0);
+
+                    /* Gang: the same job on a device per parallel port
+                     * in the gangPorts bitmask (bit 0 = LPT1) */
+                    app.get("gangPorts",gangPorts,0);
+
                     buf.set_wordsize(chip->get_wordsize());
+                    io->gang_reset();
+                    if (gangPorts != 0) {
+                        if (incrementalWrite == 0) {
+                            steps.push_back(JOB_ERASE);
+                            steps.push_back(JOB_PROGRAM);
+                        } else {
+                            steps.push_back(JOB_REPROGRAM);
+                        }
+                        steps.push_back(JOB_VERIFY);
+                        lastWrittenDevice = -1;
+                        runGangJob(gangPorts, steps, cellReport);
+                        break;
+                    }
+                    /* The read backs of the write verify the bit-parallel
+                     * targets */
+                    io->gang_read(IO::GANG_READ_VERIFY);
                     try {
-                        chip->program(buf);
+                        if (singleSession != 0) {
+                            if (incrementalWrite == 0) {
+                                steps.push_back(JOB_ERASE);
+                                steps.push_back(JOB_PROGRAM);
+                            } else {
+                                steps.push_back(JOB_REPROGRAM);
+                            }
+                            steps.push_back(JOB_VERIFY);
+                            chip->run_job(buf, steps, timings);
+                            if (incrementalWrite == 0) {
+                                erasedDevice = currentDevice;
+                            }
+                        } else if (incrementalWrite == 0) {
+                            chip->program(buf);
+                        } else if (
+                            incrementalWrite == 2 &&
+                            lastWrittenDevice == currentDevice
+                        ) {
+                            chip->reprogram(buf, &lastWritten);
+                        } else {
+                            chip->reprogram(buf);
+                        }
+                        lastWritten = buf;
+                        lastWrittenDevice = currentDevice;
+
+                        /* Tell how many EEPROM/config cells were kept */
+                        chip->get_cell_counts(cellsWritten, cellsSkipped);
+                        len = sprintf (
+                            cellReport,
+                            " Write: %lu cells written, %lu unchanged",
+                            cellsWritten,
+                            cellsSkipped
+                        );
+                        /* and the time spent by each step of the job */
+                        for (
+                            JobTimingVector::iterator n = timings.begin();
+                            n != timings.end() && len < sizeof(cellReport)-32;
+                            n++
+                        ) {
+                            len += sprintf (
+                                cellReport + len,
+                                "%s %s %.2lfs",
+                                (n == timings.begin()) ? " -" : ",",
+                                jobStepName[n->step],
+                                n->usecs / 1000000.0
+                            );
+                        }
+                        /* and the result of each bit-parallel target */
+                        gangTargetsReport(cellReport, len, sizeof(cellReport));
                     } catch(std::exception& e) {
+                        lastWrittenDevice = -1;
                         fl_alert("%s: %s",chip->get_name().c_str(),e.what());
                     }
-                break;
+                    io->gang_read(IO::GANG_READ_FIRST);
+                } break;
                 case CHIP_VERIFY: {
+                    int sparseVerify, trustErase;
+                    MismatchVector mismatches;
+
+                    /* Sparse verify: the blank regions are checked only
+                     * at VDD prog, or not at all if the device has been
+                     * erased in this session and the erase is trusted */
+                    app.get("sparseVerify",sparseVerify,0);
+                    app.get("trustErase",trustErase,0);
+                    io->gang_reset();
                     for (int i=0; i < ((io->production())?3:1); i++) {
                         if (i==1) {
                             io->vdd(IO::VDD_TO_MIN);
                         } else if (i==2) {
                             io->vdd(IO::VDD_TO_MAX);
                         }
-                        progressOperation((void*)soper[oper+i],0,-1);
+                        chip->set_sparse_verify (
+                            sparseVerify != 0 && (
+                                i > 0 || (
+                                    trustErase != 0 &&
+                                    erasedDevice == currentDevice
+                                )
+                            )
+                        );
+                        startProgress(&mainProgress, soper[oper+i]);
                         try {
-                            chip->read(buf,true);
+                            if (!chip->verify(buf,mismatches)) {
+                                /* Offer to program again the failed
+                                 * locations, then verify again */
+                                if (reportMismatches(i, mismatches, true)) {
+                                    io->vdd(IO::VDD_TO_PRG);
+                                    startProgress(&mainProgress, "Repair");
+                                    if (!chip->repair(buf,mismatches)) {
+                                        /* Checked at VDD prog. */
+                                        reportMismatches (
+                                            0, mismatches, false
+                                        );
+                                        continue;
+                                    }
+                                    if (i==1) {
+                                        io->vdd(IO::VDD_TO_MIN);
+                                    } else if (i==2) {
+                                        io->vdd(IO::VDD_TO_MAX);
+                                    }
+                                    startProgress (
+                                        &mainProgress, soper[oper+i]
+                                    );
+                                    if (!chip->verify(buf,mismatches)) {
+                                        reportMismatches (
+                                            i, mismatches, false
+                                        );
+                                    }
+                                }
+                            }
                         } catch(std::exception& e) {
                             fl_message (
                                 "%s\n\n%s",
@@ -1984,8 +2353,20 @@ char *soper[] = {
                             );
                         }
                     }
+                    chip->set_sparse_verify(false);
+
+                    /* The first bit-parallel target is verified by the
+                     * device algorithm, the others against it */
+                    if (io->gang_failed() != 0) {
+                        char report[128];
+
+                        gangTargetsReport(report, 0, sizeof(report));
+                        fl_message("Verify:%s", report + 2);
+                    }
                 } break;
                 case CHIP_TEST_ON:
+                    /* The running code may write its data EEPROM */
+                    erasedDevice = -1;
                     io->vdd(IO::VDD_TO_PRG);
                     io->vpp(IO::VPP_TO_GND);
                     io->vdd(IO::VDD_TO_ON);
@@ -1995,7 +2376,11 @@ char *soper[] = {
                 default:
                 break;
             }
-            progressOperation((void*)0,0,-1);
+            startProgress(&mainProgress, NULL);
+            if (oper == CHIP_WRITE && cellReport[0]) {
+                p_progress->label(cellReport);
+                p_progress->redraw();
+            }
         }
     }
     return true;
@@ -2003,12 +2388,10 @@ char *soper[] = {
 
 void loadHexFile(void)
 {
+static char cacheReport[128];
 char *fname;
-
-    if (hexFile) {
-        delete hexFile;
-    }
-    hexFile = 0;
+char cdir[1024];
+bool cached;
 
     fname = fl_file_chooser (
         "HEX file selection",
@@ -2017,22 +2400,35 @@ char *fname;
         0
     );
     if (fname && strlen(fname)) {
-        try {
-            /* Read the hex file into the data buffer */
-            hexFile = HexFile::load(fname);
-        } catch (std::exception& e) {
-            fl_message("%s: %s\n",fname,e.what());
-            hexFile = 0;
-            return;
-        }
         if (chip) {
+            app.get("hexCacheDir",cdir,"",sizeof(cdir));
+            hexCache.set_cache_dir(cdir);
             /* Clear the data buffer */
             buf.clear();
-            /* reads the hex file into memory */
+            /* reads the hex file (or its cached image) into memory */
+            try {
+                cached = hexCache.load(fname,buf);
+            } catch (std::exception& e) {
+                fl_message("%s: %s\n",fname,e.what());
+                return;
+            }
+            /* Tell where the image came from, and how the cache did */
+            sprintf (
+                cacheReport,
+                " Load: %s - cache %lu hits, %lu from disk, %lu parsed",
+                (cached) ? "cached image" : "file parsed",
+                hexCache.get_hits(),
+                hexCache.get_disk_hits(),
+                hexCache.get_misses()
+            );
+            p_progress->label(cacheReport);
+            p_progress->redraw();
+        } else {
             try {
-                hexFile->read(buf);
+                /* Just check that the hex file can be read */
+                delete HexFile::load(fname);
             } catch (std::exception& e) {
-                fl_message("%s\n",e.what());
+                fl_message("%s: %s\n",fname,e.what());
                 return;
             }
         }
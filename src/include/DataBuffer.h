@@ -53,6 +53,18 @@ public:
      */
     DataBuffer(int wordsize=16);
 
+    /** Constructs a DataBuffer holding a copy of another one.
+     * \param other The DataBuffer to copy.
+     */
+    DataBuffer(const DataBuffer& other);
+
+    /** Replaces the contents of this DataBuffer with a copy of another
+     * one. Only the allocated chunks are copied.
+     * \param other The DataBuffer to copy.
+     * \returns A reference to this DataBuffer.
+     */
+    DataBuffer& operator=(const DataBuffer& other);
+
     /** Frees all memory and resources associated with this instance. */
     ~DataBuffer();
 
@@ -90,6 +102,13 @@ public:
      */
     unsigned int& operator[](size_t n);
 
+    /** Gets a chunk of the buffer without allocating it.
+     * \param chunk_num The chunk number, from 0 to \c num_chunks - 1.
+     * \returns A pointer to the \c chunk_size words of the chunk, or NULL
+     *          if the chunk has never been accessed (it's blank).
+     */
+    const unsigned int *get_chunk(long chunk_num);
+
 private:
     int wordsize;
     unsigned int clearvalue;
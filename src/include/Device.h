@@ -19,12 +19,14 @@
 #ifndef __Device_h
 #define __Device_h
 
+#include <stdio.h>
 #include <vector>
 #include <string>
 
 using namespace std;
 
 #include "Preferences.h"
+#include "DeviceSpec.h"
 #include "DataBuffer.h"
 #include "IO.h"
 
@@ -36,17 +38,91 @@ using namespace std;
 typedef vector<pair <int, int> > IntPairVector;
 
 
+/** A location which failed a verify. */
+typedef struct {
+    /** The address of the location in the DataBuffer. */
+    unsigned long addr;
+    /** The bits of the location which are compared. */
+    unsigned int mask;
+    /** The value found in the DataBuffer. */
+    unsigned int expected;
+    /** The value read from the device. */
+    unsigned int actual;
+} Mismatch;
+
+/** Shortcut to a vector of mismatches, the result of a complete verify. */
+typedef vector<Mismatch> MismatchVector;
+
+
+/** The steps of a job run by Device::run_job(). */
+typedef enum {
+    JOB_CHECK,          /**< Check the device ID, see Device::check() */
+    JOB_ERASE,          /**< Erase the device, see Device::erase() */
+    JOB_BLANK_CHECK,    /**< Verify the device is blank */
+    JOB_PROGRAM,        /**< Program the device, see Device::program() */
+    JOB_REPROGRAM,      /**< Program the changes, see Device::reprogram() */
+    JOB_VERIFY          /**< Verify the device, see Device::read() */
+} JobStep;
+
+/** The time spent by a step of a job. */
+typedef struct {
+    /** The step. */
+    JobStep step;
+    /** The time spent by the step, in microseconds. */
+    microtime_t usecs;
+} JobTiming;
+
+/** Shortcut to a vector of job steps. */
+typedef vector<JobStep> JobStepVector;
+
+/** Shortcut to a vector of job step timings. */
+typedef vector<JobTiming> JobTimingVector;
+
+/** The kinds of rows of a memory dump, see Device::dump_rows(). */
+typedef enum {
+    DUMP_BLANK,         /**< An empty row between two areas */
+    DUMP_TITLE,         /**< The title of an area */
+    DUMP_RULE,          /**< A horizontal rule under the title */
+    DUMP_SPACE,         /**< A small space above the first row of an area */
+    DUMP_CODE,          /**< A disassembled program word */
+    DUMP_OPERAND,       /**< A further word of a multi-word instruction */
+    DUMP_DATA           /**< Up to 8 bytes in hex and ASCII */
+} DumpRowKind;
+
+/** A row of a memory dump, rendered by Device::dump_row(). */
+typedef struct {
+    /** The DataBuffer address of the first word of the row. */
+    unsigned long addr;
+    /** The memory map area of the row, see Device::get_mmap(). */
+    unsigned short area;
+    /** The kind of row, one of DumpRowKind. */
+    unsigned short kind;
+} DumpRow;
+
+/** Shortcut to a vector of dump rows. */
+typedef vector<DumpRow> DumpRowVector;
+
+
 /** A base class representing a memory device which can be manipulated. This
  * class contains the basic high-level operators erase, program, and read.
+ *
+ * Thread safety: a Device instance keeps all of its state in its own
+ * members, so different instances can be driven from different threads at
+ * once, each one through its own IO instance. A single instance must only
+ * be used by one thread at a time. The instances of the same device share
+ * its DeviceSpec, which never changes.
  */
 class Device
 {
 public:
     /** Creates an instance of a device given only its name. This function is
      * basically a switch which parses the name and returns an object of
-     * the subclass which describes the device.
+     * the subclass which describes the device. The settings of the device
+     * are only read the first time, see DeviceSpec::lookup().
      *
-     * \param name The name of the device (case sensitive).
+     * \param cfg The settings group of the device.
+     * \param name The vendor/spec/device path of the device (case
+     *        sensitive).
      * \retval NULL if the device is unknown.
      * \retval Device An instance of a subclass of Device representing the
      *         device given by the name parameter.
@@ -78,12 +154,88 @@ public:
      */
     virtual void program(DataBuffer& buf) = 0;
 
-    /** Dumps/disassemblates the contents of the DataBuffer.
+    /** Reprogram the device with the contents of the DataBuffer, writing
+     * only the parts which differ from what the device already contains.
+     * The default implementation erases and programs the whole device;
+     * devices which can erase a single row of memory override it. The
+     * contents of the device can only be read from the first of several
+     * bit-parallel targets (see IO::gang_targets()), so with more than one
+     * target the overrides erase and program the whole device too.
+     * \param buf The DataBuffer containing the data to program.
+     * \param current The DataBuffer with the current contents of the
+     *        device, e.g. the image programmed last time. If NULL, the
+     *        device is read first.
+     * \pre set_iodevice() must have been called with a valid IO object.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    virtual void reprogram(DataBuffer& buf, DataBuffer *current=NULL);
+
+    /** Runs a list of operations on the device in a single programming
+     * session. Devices which don't need to leave program mode between the
+     * operations keep it until the end of the job, saving the power cycles
+     * and the program mode entry delays of each operation. Program mode is
+     * entered again only where the device requires it. The read backs of
+     * the program, verify and blank check steps compare the bit-parallel
+     * targets, see IO::gang_read().
+     * \param buf The DataBuffer containing the data to program/verify.
+     * \param steps The operations to run, in order.
+     * \param timings Filled with the time spent by each operation run.
+     * \pre set_iodevice() must have been called with a valid IO object.
+     * \throws runtime_error Contains a textual description of the error.
+     *         The device is turned off and the timings hold the operations
+     *         completed before the error.
+     */
+    virtual void run_job (
+        DataBuffer& buf,
+        JobStepVector& steps,
+        JobTimingVector& timings
+    );
+
+    /** Dumps/disassemblates the contents of the DataBuffer through the
+     * dump callback, one line per row, see dump_rows().
      * \param buf The DataBuffer containing the data to dump/disassemblate.
      * \throws runtime_error Contains a textual description of the error.
      */
     virtual void dump(DataBuffer& buf);
 
+    /** Lists the rows of the dump of the DataBuffer without rendering
+     * them, so a view can render only the rows it shows with dump_row().
+     * Listing only checks which words are blank and how many words each
+     * instruction takes.
+     * \param buf The DataBuffer to dump.
+     * \param rows Filled with the rows, in order.
+     */
+    virtual void dump_rows(DataBuffer& buf, DumpRowVector& rows);
+
+    /** Renders a row of the dump of the DataBuffer. It only reads the
+     * device, so write_listing() calls it from several threads at once.
+     * \param buf The DataBuffer given to dump_rows().
+     * \param row The row to render.
+     * \param line Filled with the text of the row: the plain title of a
+     *        DUMP_TITLE row, an empty string for the rows drawn by the view.
+     * \param size The size of line.
+     */
+    virtual void dump_row (
+        DataBuffer& buf,
+        const DumpRow& row,
+        char *line,
+        size_t size
+    );
+
+    /** Writes the dump of the DataBuffer to a file as a plain text listing.
+     * The rows are listed first, then rendered in slices by several
+     * threads, each one on its own copy of the buffer, and written in
+     * order as the slices complete. An instruction split between two
+     * slices is rendered whole with the first one, as the row index
+     * already tells its operand words apart.
+     * \param buf The DataBuffer containing the data to dump/disassemblate.
+     * \param out The file to write the listing to.
+     * \param threads The number of threads rendering the rows, 0 for one
+     *        per processor.
+     * \throws runtime_error If the listing couldn't be written.
+     */
+    void write_listing(DataBuffer& buf, FILE *out, int threads = 0);
+
     /** Read the contents of a device into the DataBuffer.
      * \param buf The DataBuffer to store the read data.
      * \param verify If this flag is true, don't store the data in the
@@ -93,6 +245,29 @@ public:
      */
     virtual void read(DataBuffer& buf, bool verify=false) = 0;
 
+    /** Verify the whole device against the DataBuffer, collecting every
+     * mismatch instead of stopping at the first one.
+     * \param buf The DataBuffer containing the data to verify.
+     * \param result Filled with the locations which didn't match.
+     * \returns true if the device matches the DataBuffer.
+     * \pre set_iodevice() must have been called with a valid IO object.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    bool verify(DataBuffer& buf, MismatchVector& result);
+
+    /** Program again the locations which failed a verify. The default
+     * implementation reprograms the parts of the device which hold a
+     * mismatch (see reprogram()), then reads the device back to check the
+     * repaired locations.
+     * \param buf The DataBuffer containing the data to program.
+     * \param result The mismatches found by verify(). On return it holds
+     *        the ones which couldn't be repaired.
+     * \returns true if all the mismatches have been repaired.
+     * \pre set_iodevice() must have been called with a valid IO object.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    virtual bool repair(DataBuffer& buf, MismatchVector& result);
+
     /** Prepare the default value of the configuration registers.
      */
     virtual void set_config_default(DataBuffer& buf) = 0;
@@ -159,10 +334,71 @@ public:
         void *data=NULL
     );
 
+    /** Enables the "trust erase" fast programming mode. When the device has
+     * just been erased by this same instance, program() relies on the erase
+     * and doesn't read back the locations which must stay blank. Only
+     * electrically erasable devices take advantage of it.
+     * \param enable Enables or disables the fast mode.
+     * \param blank_check If true, the skipped locations are checked in a
+     *        final pass after programming.
+     */
+    void set_trust_erase(bool enable, bool blank_check=false);
+
+    /** Enables the sparse verify mode. When enabled, read() in verify mode
+     * checks only the locations which aren't blank in the DataBuffer, so
+     * the blank regions can be checked once (e.g. at VDDprog only) or
+     * left to a trusted erase. Devices with random access to their memory
+     * jump directly from a populated range to the next one.
+     * \param enable Enables or disables the sparse verify mode.
+     */
+    void set_sparse_verify(bool enable);
+
+    /** Sets what the device is known to hold, e.g. the base image of a
+     * PatchTemplate programmed earlier. The JOB_REPROGRAM step of run_job()
+     * compares the DataBuffer with it instead of reading the device, so
+     * only the rows which differ are written.
+     * \param current The current contents of the device, NULL to read it.
+     */
+    void set_job_base(DataBuffer *current);
+
+    /** Gets the number of data EEPROM and configuration cells written by
+     * the last programming operation, and of those skipped because they
+     * already held the value to program.
+     * \param written Set to the number of cells written.
+     * \param skipped Set to the number of cells skipped.
+     */
+    void get_cell_counts(unsigned long& written, unsigned long& skipped);
+
 protected:
+    /** Renders a DUMP_DATA row as hex bytes followed by their ASCII.
+     * \param buf The DataBuffer to dump.
+     * \param row The row to render.
+     * \param shown_addr The address printed at the start of the row.
+     * \param line Filled with the text of the row.
+     * \param size The size of line.
+     */
+    void dump_data_row (
+        DataBuffer& buf,
+        const DumpRow& row,
+        unsigned long shown_addr,
+        char *line,
+        size_t size
+    );
+
+    /** Adds a row to a dump. */
+    static void add_row (
+        DumpRowVector& rows,
+        unsigned long addr,
+        int area,
+        DumpRowKind kind
+    );
+
     /** The constructor just initializes the Device class variables to
-     * default values. */
-    Device(char *name);
+     * default values.
+     * \param spec The description of the device, shared by the instances.
+     * \param name The name of the device.
+     */
+    Device(const DeviceSpec *spec, char *name);
 
     /** Calls the progress callback, if it has been defined. The percent
      * completed will be calculated from the progress_counter and
@@ -174,6 +410,19 @@ protected:
      */
     bool progress(unsigned long addr);
 
+    /** Tells if the locations already holding the data to program can be
+     * skipped. The read deciding it sees the first bit-parallel target
+     * only, so with more than one target every location is written.
+     * \returns false if the IO drives more than one target.
+     */
+    bool can_skip_writes(void);
+
+    /** Sets how the IO reads the bit-parallel targets, see IO::gang_read().
+     * \param mode The new mode.
+     * \returns The previous mode, to restore it afterwards.
+     */
+    IO::GangRead gang_read(IO::GangRead mode);
+
     /** The size of a data word in bits. The default value for this is 8. */
     int wordsize;
 
@@ -219,11 +468,65 @@ protected:
     /** An arbitrary pointer which is passed verbatim to the dump callback. */
     void *dump_cb_data;
 
+    /** True if the "trust erase" fast programming mode is enabled. */
+    bool trust_erase;
+
+    /** True if the locations skipped in "trust erase" mode must be checked
+     * in a final pass. */
+    bool trust_erase_check;
+
+    /** Set by erase() when the whole device has been successfully erased,
+     * cleared as soon as something is written to it. */
+    bool erased;
+
+    /** Called at the end of run_job(), after \c in_session has been
+     * cleared, to leave the program mode kept across the steps. The
+     * default does nothing.
+     */
+    virtual void end_session(void);
+
+    /** True while run_job() is running a job. */
+    bool in_session;
+
+    /** Called by read() in verify mode when a location doesn't match.
+     * \param addr The address of the location in the DataBuffer.
+     * \param mask The bits of the location which are compared.
+     * \param expected The value in the DataBuffer.
+     * \param actual The value read from the device.
+     * \returns true if the mismatch has been collected by verify() and
+     *          the verify can go on, false if it must stop with an error.
+     */
+    bool mismatch (
+        unsigned long addr,
+        unsigned int mask,
+        unsigned int expected,
+        unsigned int actual
+    );
+
+    /** Where verify() collects the mismatches, NULL to stop at the first
+     * one. */
+    MismatchVector *mismatches;
+
+    /** True if read() in verify mode skips the blank locations. */
+    bool sparse_verify;
+
+    /** What the JOB_REPROGRAM step compares with, NULL to read the
+     * device. */
+    DataBuffer *job_base;
+
+    /** The data EEPROM and configuration cells written by the last
+     * programming operation. */
+    unsigned long cells_written;
+
+    /** The cells left alone by the last programming operation because they
+     * already held the value to program. */
+    unsigned long cells_skipped;
+
     /** The name of the device that was given to the constructor. */
     string name;
 
-    /** The settings for the device */
-    static Preferences *config;
+    /** The description of the device, given to the constructor */
+    const DeviceSpec *spec;
 };
 
 
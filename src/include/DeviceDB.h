@@ -0,0 +1,151 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __DeviceDB_h
+#define __DeviceDB_h
+
+#include <stdint.h>
+
+#include "Preferences.h"
+
+/** \file */
+
+
+/** A compiled, read-only copy of the devices settings. The vendor/spec/
+ * device tree of the settings is compiled once into a binary file with a
+ * perfect hash index of the device names and the entries sorted by key,
+ * then mapped in memory: looking up a device and its entries takes no
+ * parsing of the settings, and all the processes using the same file share
+ * it. The entries are kept as text, DeviceSpec parses them as Preferences
+ * does.
+ *
+ * The file is only valid on machines with the byte order and type sizes
+ * of the one which compiled it, as a cache should.
+ */
+class DeviceDB
+{
+public:
+    /** Constructs a closed database. */
+    DeviceDB();
+
+    /** Closes the database. */
+    ~DeviceDB();
+
+    /** Compiles the devices settings into a database file.
+     * \param devices The devices settings, see Device::load().
+     * \param filename The name of the file to write.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    static void compile(Preferences& devices, const char *filename);
+
+    /** Opens a database file.
+     * \param filename The name of the file to open.
+     * \returns false if the file doesn't exist or isn't a valid database.
+     */
+    bool open(const char *filename);
+
+    /** Opens the database cached with the devices settings, compiling it
+     * first if it is missing or not newer than the settings file.
+     * \param devices The devices settings, see Device::load().
+     * \returns false if the database couldn't be compiled or opened.
+     */
+    bool open_cached(Preferences& devices);
+
+    /** Closes the database. */
+    void close(void);
+
+    /** \returns true if the database is open. */
+    bool is_open(void) { return image != NULL; }
+
+    /** \returns The number of devices. */
+    unsigned int get_devices(void);
+
+    /** \returns The vendor/spec/device path of a device, to be given to
+     * Device::load(). */
+    const char *get_path(unsigned int dev);
+
+    /** \returns The number of entries of a device. */
+    unsigned int get_entries(unsigned int dev);
+
+    /** \returns The name of an entry of a device, the entries being sorted
+     * by name. */
+    const char *get_entry(unsigned int dev, unsigned int entry);
+
+    /** \returns The text of an entry of a device, as in the settings. */
+    const char *get_text(unsigned int dev, unsigned int entry);
+
+    /** Looks up a device.
+     * \param name The vendor/spec/device path of the device, or just its
+     *        name if no other vendor or family uses it.
+     * \returns The device number, or -1 if not found.
+     */
+    int find(const char *name);
+
+    /** \returns The text of an entry of a device, NULL if it is missing. */
+    const char *get(unsigned int dev, const char *key);
+
+private:
+    typedef struct {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size;          /* Of the whole file */
+        uint32_t devices;
+        uint32_t keys;
+        uint32_t names;         /* Hash index entries */
+        uint32_t buckets;
+        uint32_t fields;
+        uint32_t field_off;     /* Field[fields] */
+        uint32_t record_off;    /* Record[devices] */
+        uint32_t key_off;       /* uint32_t[keys]: sorted key names */
+        uint32_t bucket_off;    /* uint32_t[buckets]: displacements */
+        uint32_t slot_off;      /* uint32_t[2*names]: name, device pairs */
+        uint32_t string_off;    /* char[string_size] */
+        uint32_t string_size;
+        uint32_t reserved;
+    } Header;
+
+    typedef struct {
+        uint32_t path;
+        uint32_t first_field;   /* Sorted by key */
+        uint32_t num_fields;
+    } Record;
+
+    typedef struct {
+        uint32_t key;
+        uint32_t text;
+    } Field;
+
+    static uint32_t hash(const char *name, uint32_t seed);
+    bool check(void);
+    const Field *find_field(unsigned int dev, const char *key);
+    const char *str(uint32_t offset) { return strings + offset; }
+
+    const unsigned char *image;
+    unsigned long image_size;
+    bool mapped;
+
+    const Header *header;
+    const Field *fields;
+    const Record *records;
+    const uint32_t *keys;
+    const uint32_t *buckets;
+    const uint32_t *slots;
+    const char *strings;
+};
+
+
+#endif
@@ -0,0 +1,124 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __DeviceSpec_h
+#define __DeviceSpec_h
+
+#include <vector>
+#include <string>
+
+#include "Preferences.h"
+#include "DeviceDB.h"
+
+using namespace std;
+
+/** \file */
+
+
+/** The description of a device: the entries of its devices settings group,
+ * parsed once into numbers. A spec is built the first time a device is
+ * looked up and kept in a registry for the life of the program, so
+ * selecting the device again, or creating a Device instance for each gang
+ * slot, reuses it.
+ *
+ * A spec never changes once built: any number of Device instances and
+ * threads can read it at the same time. The registry itself is not locked,
+ * lookup() and forget() must be called from a single thread, as
+ * Device::load() already is.
+ */
+class DeviceSpec
+{
+public:
+    /** Finds the spec of a device, reading it from the devices settings
+     * the first time.
+     * \param config The settings group of the device.
+     * \param path The vendor/spec/device path of the device.
+     * \returns The spec, owned by the registry.
+     */
+    static const DeviceSpec *lookup(Preferences *config, const char *path);
+
+    /** Finds the spec of a device, reading it from a compiled devices
+     * database the first time.
+     * \param db The open database.
+     * \param dev The device number, see DeviceDB::find().
+     * \returns The spec, owned by the registry.
+     */
+    static const DeviceSpec *lookup(DeviceDB& db, unsigned int dev);
+
+    /** Drops a spec from the registry after its settings changed, so the
+     * next lookup reads them again. The Device instances using the old
+     * spec keep it.
+     * \param path The vendor/spec/device path of the device, or NULL to
+     *        drop all the specs.
+     */
+    static void forget(const char *path = NULL);
+
+    /** \returns The vendor/spec/device path of the device. */
+    const string& get_path(void) const { return path; }
+
+    /** Reads an integer entry, as Preferences::get() does.
+     * \returns false if the entry is missing.
+     */
+    bool get(const char *key, int& value, int defaultValue) const;
+
+    /** Reads a numeric entry, as Preferences::get() does.
+     * \returns false if the entry is missing.
+     */
+    bool get(const char *key, double& value, double defaultValue) const;
+
+    /** Copies the text of an entry, as Preferences::get() does.
+     * \returns false if the entry is missing.
+     */
+    bool get (
+        const char *key,
+        char *value,
+        const char *defaultValue,
+        int maxSize
+    ) const;
+
+    /** Reads a hexadecimal entry, as Preferences::getHex() does: the value
+     * is 0 if the entry is missing or not a number, whatever the default
+     * value, which is there to keep the same signature.
+     * \returns false if the entry is missing or not a number.
+     */
+    bool getHex(const char *key, int& value, int defaultValue) const;
+
+private:
+    typedef struct {
+        string key;
+        string text;
+        int ivalue;
+        double dvalue;
+        int hvalue;
+        bool hex;       /* The text is a valid hex number */
+    } Entry;
+
+    DeviceSpec(const char *path);
+
+    void add(const char *key, const char *text);
+    static bool less(const Entry& a, const Entry& b);
+    const Entry *find(const char *key) const;
+
+    static const DeviceSpec *registered(const char *path);
+    static const DeviceSpec *enroll(DeviceSpec *spec);
+
+    string path;
+    vector<Entry> entries;  /* Sorted by key */
+};
+
+
+#endif
@@ -39,10 +39,11 @@ public:
      * effective UID back to the read UID (effectively dropping root
      * permissions on SUID executables).
      *
+     * \param config The settings for the programmer to use.
      * \param port The number of the parallel port to use. 
      * \throws runtime_error Contains a textual description of the error.
      */
-    DirectPPIO(int port);
+    DirectPPIO(Preferences *config, int port);
 
     /** Destructor */
     ~DirectPPIO();
@@ -62,6 +63,9 @@ public:
         short invert
     );
 
+    unsigned int get_register(char *name, short reg);
+    void set_register(char *name, short reg, unsigned int value);
+
 private:
     int ioport;
     int regs;
@@ -0,0 +1,171 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __GangProgrammer_h
+#define __GangProgrammer_h
+
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#include <vector>
+#include <string>
+
+#include "Preferences.h"
+#include "DataBuffer.h"
+#include "Device.h"
+#include "IO.h"
+
+using namespace std;
+
+/** \file */
+
+
+/** The state of a gang programming slot. */
+typedef enum {
+    SLOT_IDLE,      /**< No job run yet */
+    SLOT_RUNNING,   /**< The job is running */
+    SLOT_PASSED,    /**< The job completed successfully */
+    SLOT_FAILED     /**< The job failed, see GangProgrammer::get_error() */
+} GangSlotState;
+
+
+/** Runs the same job on several devices at once, one per parallel port.
+ * Each slot owns its IO, its Device instance and its copy of the data to
+ * program, and runs the job in its own thread, so N parts take about the
+ * time of a single one.
+ *
+ * The slots must be added from a single thread. While the job runs, each
+ * thread only touches the objects of its slot.
+ */
+class GangProgrammer
+{
+public:
+    /** Constructs a gang programmer without slots. */
+    GangProgrammer();
+
+    /** Waits for the running job and frees all the slots. */
+    ~GangProgrammer();
+
+    /** Adds a slot programming a device through a parallel port.
+     * \param programmer The programmer settings, see IO::acquire().
+     * \param method The name of the IO hardware access method.
+     * \param port The parallel port number.
+     * \param devices The devices settings, see Device::load().
+     * \param device The name of the device.
+     * \returns The slot number.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    unsigned int add_slot (
+        Preferences *programmer,
+        char *method,
+        int port,
+        Preferences *devices,
+        char *device
+    );
+
+    /** Frees all the slots, with their IO and Device instances. */
+    void clear(void);
+
+    /** \returns The number of slots. */
+    unsigned int get_slots(void) { return slots.size(); }
+
+    /** \returns The Device instance of a slot, to set its options. */
+    Device *get_device(unsigned int slot) { return slots[slot]->chip; }
+
+    /** \returns The IO instance of a slot. */
+    IO *get_io(unsigned int slot) { return slots[slot]->io; }
+
+    /** \returns The parallel port number of a slot. */
+    int get_port(unsigned int slot) { return slots[slot]->port; }
+
+    /** Starts a job on all the slots. Each slot programs its own copy of
+     * \c buf, with the supply voltage set to VDD_TO_PRG, and turns the
+     * port off at the end. The call returns at once: use running() or
+     * wait() to know when the job is over.
+     * \param buf The DataBuffer containing the data to program.
+     * \param steps The operations to run, see Device::run_job().
+     * \throws runtime_error If a thread can't be started. The slots
+     *         already started keep running.
+     */
+    void start(DataBuffer& buf, JobStepVector& steps);
+
+    /** \returns true while the job is running on any slot. */
+    bool running(void);
+
+    /** Waits for the job to complete on all the slots.
+     * \returns true if the job passed on all the slots.
+     */
+    bool wait(void);
+
+    /** \returns The state of a slot. */
+    GangSlotState get_state(unsigned int slot) { return slots[slot]->state; }
+
+    /** \returns The progress of the operation a slot is running, in
+     * percent. */
+    int get_progress(unsigned int slot) { return slots[slot]->progress; }
+
+    /** \returns The error which made a slot fail, once it is no longer
+     * running. */
+    const char *get_error(unsigned int slot) {
+        return slots[slot]->error.c_str();
+    }
+
+    /** \returns The time spent by each step of the job on a slot. */
+    JobTimingVector& get_timings(unsigned int slot) {
+        return slots[slot]->timings;
+    }
+
+    /** \returns The wall time spent by the last job up to the end of the
+     * slowest slot, in microseconds. */
+    microtime_t get_elapsed(void);
+
+private:
+    typedef struct {
+        int port;
+        IO *io;
+        Device *chip;
+        DataBuffer *buf;
+        JobStepVector steps;
+        JobTimingVector timings;
+        string error;
+        volatile GangSlotState state;
+        volatile int progress;
+        microtime_t finished;
+        bool started;
+#ifdef WIN32
+        HANDLE thread;
+#else
+        pthread_t thread;
+#endif
+    } Slot;
+
+#ifdef WIN32
+    static DWORD WINAPI run_slot(LPVOID data);
+#else
+    static void *run_slot(void *data);
+#endif
+    static bool slot_progress(void *data, long addr, int percent);
+
+    vector<Slot *> slots;
+    microtime_t started;
+};
+
+
+#endif
@@ -0,0 +1,110 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __HexCache_h
+#define __HexCache_h
+
+#include <time.h>
+#include <list>
+#include <string>
+
+#include "DataBuffer.h"
+
+using namespace std;
+
+/** \file */
+
+
+/** A cache of decoded hex file images. The images are kept in memory (the
+ * least recently used ones are dropped first), identified by the path of
+ * the file, its size, its modification time (to the nanosecond where the
+ * system has it) and a hash of its contents, so a changed file is parsed
+ * again. The file is read to hash it only when it isn't in memory, or when
+ * it was cached within the same modification time tick: a rebuild in that
+ * tick may keep both the size and the modification time. When a cache
+ * directory is set, the images are also saved on disk to survive program
+ * restarts, identified by the size and the hash.
+ */
+class HexCache
+{
+public:
+    /** Constructs an empty cache.
+     * \param max_entries The maximum number of images kept in memory.
+     */
+    HexCache(unsigned int max_entries=8);
+
+    /** Frees all the cached images. */
+    ~HexCache();
+
+    /** Sets the directory where the images are saved on disk.
+     * \param dir The cache directory, NULL or "" to disable the disk cache.
+     */
+    void set_cache_dir(const char *dir);
+
+    /** Loads a hex file into a DataBuffer, using the cached image if the
+     * file didn't change since it was decoded the last time. The image is
+     * decoded according to the word size of \c buf. A hit still copies
+     * the cached image into \c buf, chunk by chunk, as the caller goes on
+     * changing it (e.g. the configuration words).
+     * \param filename The name of the hex file to load.
+     * \param buf The DataBuffer to store the data in.
+     * \returns true if the image came from the cache.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    bool load(const char *filename, DataBuffer& buf);
+
+    /** Drops all the images cached in memory. */
+    void clear(void);
+
+    /** \returns The number of loads served from the memory cache. */
+    unsigned long get_hits(void) { return hits; }
+
+    /** \returns The number of loads served from the disk cache. */
+    unsigned long get_disk_hits(void) { return disk_hits; }
+
+    /** \returns The number of loads which required parsing the file. */
+    unsigned long get_misses(void) { return misses; }
+
+private:
+    typedef struct {
+        string path;
+        unsigned long size;
+        time_t mtime;
+        long mtime_ns;
+        time_t checked;         /* When the contents were last known to
+                                 * match the hash, taken before reading */
+        unsigned long hash;
+        DataBuffer *image;
+    } Entry;
+
+    bool load_from_disk(Entry& entry);
+    void save_to_disk(Entry& entry);
+    string disk_name(Entry& entry);
+
+    static unsigned long hash_file(const char *filename);
+
+    list<Entry> entries;        /* Most recently used first */
+    unsigned int max_entries;
+    string cache_dir;
+
+    unsigned long hits;
+    unsigned long disk_hits;
+    unsigned long misses;
+};
+
+
+#endif
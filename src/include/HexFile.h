@@ -151,4 +151,106 @@ private:
 };
 
 
+/** Base class for the binary object file loaders (ELF, COFF). The whole
+ * file is mapped in memory and the loadable sections are copied straight
+ * from the mapping into the DataBuffer, without any text conversion.
+ * Object files can only be read.
+ */
+class HexFile_obj : public HexFile
+{
+public:
+    /** Unmaps the object file image. */
+    ~HexFile_obj();
+
+    /** Object files can't be written.
+     * \throws logic_error Always.
+     */
+    void write(DataBuffer& buf, long start, long len);
+
+protected:
+    /** Constructor which takes a file handle.
+     * \param fp A handle to the file to read.
+     */
+    HexFile_obj(FILE *fp);
+
+    /** Maps the whole file in memory, if it is not mapped yet.
+     * \throws runtime_error If the file couldn't be mapped.
+     */
+    void map_image(void);
+
+    /** Releases the memory mapping of the file. */
+    void unmap_image(void);
+
+    /** Copies a span of bytes in the DataBuffer, honoring the word size
+     * of the buffer the same way HexFile_ihx8 does: 8 bit buffers are
+     * byte addressed, 16 bit buffers get two bytes per word, low byte
+     * first.
+     * \param buf The DataBuffer to store the data in.
+     * \param addr The byte address of the first byte.
+     * \param data Pointer to the first byte.
+     * \param len The number of bytes to copy.
+     * \throws runtime_error If the buffer word size isn't supported.
+     */
+    void store(
+        DataBuffer& buf,
+        unsigned long addr,
+        const unsigned char *data,
+        unsigned long len
+    );
+
+    /** Checks that a span lies inside the mapped image.
+     * \returns true if [offset,offset+len) is inside the image.
+     */
+    bool inside(unsigned long offset, unsigned long len);
+
+    /** Reads a 16 bit value from the image at the given offset. */
+    unsigned int get16(unsigned long offset, bool big_endian=false);
+
+    /** Reads a 32 bit value from the image at the given offset. */
+    unsigned long get32(unsigned long offset, bool big_endian=false);
+
+    /** The file image */
+    const unsigned char *image;
+
+    /** The size in bytes of the file image */
+    unsigned long image_size;
+
+private:
+    bool mapped;            /* True if image comes from mmap() */
+};
+
+
+/** A HexFile subclass which loads the PT_LOAD program headers (or the
+ * allocated PROGBITS sections, if there are no program headers) of a 32 bit
+ * ELF object. Load addresses are byte addresses, as in Intel hex8 files.
+ */
+class HexFile_elf : public HexFile_obj
+{
+public:
+    /** Constructor which takes a file handle.
+     * \param fp A handle to the file to read.
+     */
+    HexFile_elf(FILE *fp);
+
+    void read(DataBuffer& buf);
+};
+
+
+/** A HexFile subclass which loads the code and ROM data sections of a
+ * Microchip PIC COFF object (version 1 and 2). Section addresses are
+ * word addresses for the devices having a ROM wider than 8 bits, so they
+ * are converted to byte addresses before storing the data.
+ */
+class HexFile_coff : public HexFile_obj
+{
+public:
+    /** Constructor which takes a file handle.
+     * \param fp A handle to the file to read.
+     */
+    HexFile_coff(FILE *fp);
+
+    void read(DataBuffer& buf);
+};
+
+
 #endif
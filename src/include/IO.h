@@ -53,6 +53,12 @@ struct signal_delays {
 
 /**
  * A base class for lowlevel access methods to the PIC programmer.
+ *
+ * Thread safety: each instance keeps its own settings and pin state, so
+ * instances acquired on different ports can be used from different
+ * threads at once. A single instance must only be used by one thread at a
+ * time, and the Preferences object given to acquire() must not be changed
+ * while it is in use.
  */
 class IO
 {
@@ -71,9 +77,20 @@ public:
         VPP_TO_VDD
     } VppMode;
 
+    /** How shift_bits_in() reads the targets of a bit-parallel gang */
+    typedef enum _GangRead {
+        GANG_READ_FIRST=0,  /**< The first target only */
+        GANG_READ_VERIFY,   /**< The first target, the others are compared
+                             *   to it, see gang_failed() */
+        GANG_READ_ANY       /**< The OR of all the targets, to poll a busy
+                             *   bit until all of them are done */
+    } GangRead;
+
     /** Creates an instance of an IO class from it's name.
      * \param config The settings for the IO hardware to use.
-     * \param name The name of the IO hardware to use.
+     * \param name The name of the IO hardware to use. "Simulated" drives
+     *        a simulated target instead of a port, see SimIO, and
+     *        "Simulated18" the data EEPROM of a PIC18, see Sim18IO.
      * \param port The port number to pass to the specific subclass
      *        constructor.
      * \returns An instance of the IO subclass that implements the
@@ -141,6 +158,12 @@ public:
      */
     virtual void usleep(microtime_t us);
 
+    /** Reads a free running microsecond clock, to measure how long an
+     * operation takes.
+     * \returns The current time in microseconds.
+     */
+    microtime_t now(void);
+
     /**
      * Sends a stream of up to 32 bits on the data signal, clocked by the
      * clock signal. The bits are sent LSB first and it is assumed that
@@ -198,6 +221,34 @@ public:
         microtime_t tlow = 1
     );
 
+    /** Gets the number of target devices driven at once. Programmers
+     * wired for bit-parallel gang programming share the clock, Vpp and Vdd
+     * lines and give each target its own data lines.
+     * \returns The number of targets, 1 for a normal programmer.
+     */
+    virtual int gang_targets(void) { return 1; }
+
+    /** Gets the targets whose data read back differed from the one of the
+     * first target, in the GANG_READ_VERIFY reads since the last
+     * gang_reset(). The device algorithms verify the first target, so the
+     * others passed if their bit is 0.
+     * \returns A bitmask of the failed targets, bit 0 = first target.
+     */
+    virtual uint32_t gang_failed(void) { return 0; }
+
+    /** Clears the failed targets bitmask, see gang_failed(). */
+    virtual void gang_reset(void) { }
+
+    /** Sets how the bit-parallel gang targets are read. Only the verify
+     * reads compare them: a read deciding what to write, or polling a busy
+     * bit, is not a failure when the targets differ. The default is
+     * GANG_READ_FIRST.
+     */
+    virtual void gang_read(GangRead) { }
+
+    /** \returns How the bit-parallel gang targets are read. */
+    virtual GangRead gang_read(void) { return GANG_READ_FIRST; }
+
     virtual void set_pin_state (
         char *name,
         short reg,
@@ -215,9 +266,10 @@ public:
 
 protected:
     /** Constructor
+     * \param config The settings for the programmer to use.
      * \param port A subclass specific port number.
      */
-    IO(int port);
+    IO(Preferences *config, int port);
 
     /** The programmer attached to the parallel port is a production programmer
      */
@@ -228,9 +280,9 @@ protected:
      */
     bool saVddVppControl_;
 
-    /** The settings for the programmer to use
+    /** The settings for the programmer to use, given to the constructor
      */
-    static Preferences *config;
+    Preferences *config;
 
     /** Reads the signal propagation delays from the configuration file.
      * \param name The name of the signal
@@ -35,10 +35,11 @@ public:
      * This constructor will open and initialize the parallel port ppdev
      * device. Both DevFS and pre-DevFS setups are supported.
      *
+     * \param config The settings for the programmer to use.
      * \param port The number of the parallel port to use. 
      * \throws runtime_error Contains a textual description of the error.
      */
-    LinuxPPDevIO(int port);
+    LinuxPPDevIO(Preferences *config, int port);
 
     /** Destructor */
     ~LinuxPPDevIO();
@@ -58,6 +59,9 @@ public:
         short invert
     );
 
+    unsigned int get_register(char *name, short reg);
+    void set_register(char *name, short reg, unsigned int value);
+
 private:
     int fd;
 };
@@ -27,6 +27,9 @@
 
 #define PINDECL(prefix) short prefix##Reg, prefix##Bit, prefix##Invert
 
+/** Maximum number of targets of a bit-parallel gang programmer */
+#define MAX_GANG_TARGETS 8
+
 /** This class contains methods and data elements that are common to all IO
  * implementation attached to a parallel port.
  */
@@ -36,9 +39,10 @@ public:
     /** This constructor is called right before a parallel port IO class is
      * created. It the responsibility of this function to read in the
      * configuration variables specific to parallel port programmers.
+     * \param config The settings for the programmer to use.
      * \param port The parallel port number that is being opened.
      */
-    ParallelPort(int port);
+    ParallelPort(Preferences *config, int port);
 
     /** Frees all memory and resources associated with this object */
     virtual ~ParallelPort();
@@ -49,6 +53,22 @@ public:
     virtual void vpp(VppMode mode);
     virtual void vdd(VddMode mode);
 
+    /** Reads a stream of bits from all the gang targets at once. The bits
+     * of the first target are returned, the ones of the others are compared
+     * against them or ORed with them, see IO::gang_read().
+     */
+    virtual uint32_t shift_bits_in (
+        int numbits,
+        microtime_t tdly = 1,
+        microtime_t tlow = 1
+    );
+
+    virtual int gang_targets(void) { return gangTargets; }
+    virtual uint32_t gang_failed(void) { return gangFailed; }
+    virtual void gang_reset(void) { gangFailed = 0; }
+    virtual void gang_read(GangRead mode) { gangRead = mode; }
+    virtual GangRead gang_read(void) { return gangRead; }
+
     static LptPorts ports;
 
 protected:
@@ -71,6 +91,37 @@ protected:
     int vppOffCond;       /** True if the selVihhVpp pin has to be off before
                            *  setting off the icspVppOn pin */
 
+    int gangTargets;      /** Number of targets, 1 if not a gang programmer */
+    short gangDataOutBit[MAX_GANG_TARGETS];    /** Data out pin bits        */
+    short gangDataOutInvert[MAX_GANG_TARGETS]; /** Data out pin inversion   */
+    short gangDataInBit[MAX_GANG_TARGETS];     /** Data in pin bits         */
+    short gangDataInInvert[MAX_GANG_TARGETS];  /** Data in pin inversion    */
+    uint32_t gangBits;    /** Data in bits of the targets, last read     */
+    uint32_t gangFailed;  /** Targets whose read data differed, bit mask */
+    GangRead gangRead;    /** How the targets are read, see IO::gang_read() */
+
+    /** Reads the gang targets pins "icspDataOut2", "icspDataIn2", ... The
+     * data out pins must be in the register of icspDataOut and the data in
+     * pins in the one of icspDataIn, so all the targets are accessed with a
+     * single register access.
+     * \throws runtime_error If a pin is invalid.
+     */
+    void read_gang_pins(void);
+
+    /** Reads a whole parallel port register.
+     * \param name The name of the signal being read, for error messages.
+     * \param reg The register offset.
+     * \returns The register value.
+     */
+    virtual unsigned int get_register(char *name, short reg) = 0;
+
+    /** Writes a whole parallel port register.
+     * \param name The name of the signal being set, for error messages.
+     * \param reg The register offset.
+     * \param value The register value.
+     */
+    virtual void set_register(char *name, short reg, unsigned int value) = 0;
+
     virtual void set_pin_state (
         char *name,
         short reg,
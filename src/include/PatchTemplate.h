@@ -0,0 +1,145 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __PatchTemplate_h
+#define __PatchTemplate_h
+
+#include <vector>
+#include <string>
+
+#include "DataBuffer.h"
+
+using namespace std;
+
+/** \file */
+
+
+/** How the value of a patch slot is stored in its cells. */
+typedef enum {
+    PATCH_BINARY_LE,    /**< Binary, least significant cell first */
+    PATCH_BINARY_BE,    /**< Binary, most significant cell first */
+    PATCH_BCD,          /**< Packed BCD, most significant digits first */
+    PATCH_ASCII_DEC,    /**< ASCII decimal digits, one per cell */
+    PATCH_ASCII_HEX     /**< ASCII hex digits, one per cell */
+} PatchFormat;
+
+/** A location of the per-unit overlay. */
+typedef struct {
+    /** The address of the location in the DataBuffer. */
+    unsigned long addr;
+    /** The value to store at the location. */
+    unsigned int value;
+} PatchCell;
+
+/** Shortcut to a vector of patched locations. */
+typedef vector<PatchCell> PatchCellVector;
+
+
+/** An image shared by a batch of units, with slots patched for each unit,
+ * such as a serial number in the ID locations or a calibration value in
+ * the EEPROM. The base image is loaded once; the overlay of each unit only
+ * holds the locations of the slots, so it is built and applied in a time
+ * proportional to the size of the slots, not of the image.
+ */
+class PatchTemplate
+{
+public:
+    /** Constructs a template without slots.
+     * \param base The image shared by all the units. It must not change
+     *        while the template is in use.
+     */
+    PatchTemplate(DataBuffer& base);
+
+    /** Adds a slot.
+     * \param name The name of the slot, used in the log.
+     * \param addr The DataBuffer address of the first cell of the slot.
+     * \param width The number of cells of the slot.
+     * \param format How the value is stored in the cells.
+     * \param start The value for the first unit.
+     * \param step The value added after each unit, 0 for a value set with
+     *        set_value() (e.g. a measured calibration).
+     * \param bits The number of bits of the value stored in each cell, for
+     *        the binary and BCD formats.
+     * \param fill The bits set in each cell besides the value, e.g. 0x3400
+     *        to store the value in RETLW instructions.
+     * \returns The slot number.
+     * \throws runtime_error If the slot overlaps another one.
+     */
+    unsigned int add_slot (
+        const char *name,
+        unsigned long addr,
+        unsigned int width,
+        PatchFormat format,
+        unsigned long start = 0,
+        long step = 1,
+        unsigned int bits = 8,
+        unsigned int fill = 0
+    );
+
+    /** \returns The number of slots. */
+    unsigned int get_slots(void) { return slots.size(); }
+
+    /** Sets the value of a slot for the current unit. */
+    void set_value(unsigned int slot, unsigned long value);
+
+    /** \returns The value of a slot for the current unit. */
+    unsigned long get_value(unsigned int slot) { return slots[slot].value; }
+
+    /** Builds the overlay of the current unit.
+     * \param cells Filled with the locations of all the slots.
+     * \throws runtime_error If a value doesn't fit in its slot.
+     */
+    void make_overlay(PatchCellVector& cells);
+
+    /** Turns a copy of the base image into the image of the current unit:
+     * the locations patched by the previous call are restored from the base
+     * and the overlay of the current unit is stored.
+     * \param image A copy of the base image, only ever patched through this
+     *        method.
+     * \throws runtime_error If a value doesn't fit in its slot.
+     */
+    void apply(DataBuffer& image);
+
+    /** Moves to the next unit, adding its step to the value of each
+     * slot. */
+    void next(void);
+
+    /** \returns The values of the current unit, as "name=value" pairs
+     * separated by spaces, to log what was injected. */
+    string describe(void);
+
+private:
+    typedef struct {
+        string name;
+        unsigned long addr;
+        unsigned int width;
+        PatchFormat format;
+        unsigned long value;
+        long step;
+        unsigned int bits;
+        unsigned int fill;
+    } Slot;
+
+    void encode(Slot& slot, PatchCellVector& cells);
+
+    DataBuffer *base;
+    vector<Slot> slots;
+    PatchCellVector overlay;    /* The overlay stored by apply() */
+};
+
+
+#endif
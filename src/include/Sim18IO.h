@@ -0,0 +1,130 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __Sim18IO_h
+#define __Sim18IO_h
+
+#include <vector>
+
+#include "IO.h"
+
+using namespace std;
+
+/** \file */
+
+/**
+ * An implementation of the IO interface which drives no hardware but
+ * simulates the data EEPROM of a PIC18 target on the other side of the
+ * cable. The target is modeled a frame at a time: the 4 bit commands and
+ * their 16 bit operands, of which the core instructions used to reach the
+ * data EEPROM (movlw, movwf, movf, incf, bsf and bcf) are run on a
+ * register file and 1024 bytes of data EEPROM. A write completes at once.
+ * The program and configuration memory read blank and ignore the writes.
+ *
+ * The delays take no time, but the time a real port would take to clock
+ * the bits and wait the delays is accounted while the data EEPROM is
+ * selected (EECON1 EEPGD and CFGS clear), to measure the data EEPROM
+ * throughput of the programming algorithms.
+ */
+class Sim18IO : public IO
+{
+public:
+    /** Creates a simulated target with all of its memory blank.
+     * \param config The settings for the programmer to use.
+     * \param port The number of the target, only used to tell them apart.
+     */
+    Sim18IO(Preferences *config, int port);
+
+    /** Destructor */
+    ~Sim18IO();
+
+    void clock(bool state);
+    void data(bool state);
+    bool data(void);
+    void vpp(VppMode mode);
+    void vdd(VddMode mode);
+    void usleep(microtime_t us);
+
+    void shift_bits_out (
+        uint32_t bits,
+        int numbits,
+        microtime_t tset  = 1,
+        microtime_t thold = 1
+    );
+
+    uint32_t shift_bits_in (
+        int numbits,
+        microtime_t tdly = 1,
+        microtime_t tlow = 1
+    );
+
+    void set_pin_state (
+        char *name,
+        short reg,
+        short bit,
+        short invert,
+        bool state
+    );
+
+    bool get_pin_state (
+        char *name,
+        short reg,
+        short bit,
+        short invert
+    );
+
+    /** Reads a byte of the simulated data EEPROM.
+     * \param addr The byte offset into the data EEPROM.
+     */
+    unsigned int get_byte(unsigned long addr);
+
+    /** Writes a byte of the simulated data EEPROM directly, as a previous
+     * programming would have left it, see get_byte().
+     */
+    void set_byte(unsigned long addr, unsigned int value);
+
+    /** Clears the data EEPROM traffic counters. */
+    void reset_counters(void);
+
+    /** \returns The bits clocked while the data EEPROM was selected. */
+    unsigned long get_bits(void) { return bits; }
+
+    /** \returns The frames (commands, operands and data) clocked while the
+     * data EEPROM was selected. */
+    unsigned long get_frames(void) { return frames; }
+
+    /** \returns The time, in microseconds, a real port would have taken for
+     * the bits and delays while the data EEPROM was selected. */
+    microtime_t get_time(void) { return time; }
+
+private:
+    bool ee_selected(void);
+    void execute(uint32_t instruction);
+    void account(microtime_t us);
+
+    vector<unsigned int> eeprom;    /* 1024 bytes */
+    unsigned int reg[256];          /* The access bank */
+    unsigned int w;
+
+    uint32_t last_command;          /* The command waiting for its frame */
+
+    unsigned long bits;
+    unsigned long frames;
+    microtime_t time;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef __SimIO_h
+#define __SimIO_h
+
+#include <vector>
+
+#include "IO.h"
+
+using namespace std;
+
+/** \file */
+
+/**
+ * An implementation of the IO interface which drives no hardware but
+ * simulates a mid-range (PIC16) target on the other side of the cable.
+ * The target is modeled a frame at a time: the 6 bit commands of the
+ * serial programming protocol and their 16 bit data frames, with 0x2000
+ * words of program memory, the configuration memory from 0x2000 and 256
+ * bytes of data EEPROM. Like a real part, the program memory address
+ * wraps around at 0x2000 and the EEPROM address is the low byte of the
+ * program counter. The delays take no time.
+ *
+ * Each instance simulates its own target, so instances can be driven
+ * from different threads at once, like the other IO classes.
+ */
+class SimIO : public IO
+{
+public:
+    /** Creates a simulated target with all of its memory blank.
+     * \param config The settings for the programmer to use.
+     * \param port The number of the target, only used to tell them apart.
+     */
+    SimIO(Preferences *config, int port);
+
+    /** Destructor */
+    ~SimIO();
+
+    void clock(bool state);
+    void data(bool state);
+    bool data(void);
+    void vpp(VppMode mode);
+    void vdd(VddMode mode);
+    void usleep(microtime_t us);
+
+    void shift_bits_out (
+        uint32_t bits,
+        int numbits,
+        microtime_t tset  = 1,
+        microtime_t thold = 1
+    );
+
+    uint32_t shift_bits_in (
+        int numbits,
+        microtime_t tdly = 1,
+        microtime_t tlow = 1
+    );
+
+    void set_pin_state (
+        char *name,
+        short reg,
+        short bit,
+        short invert,
+        bool state
+    );
+
+    bool get_pin_state (
+        char *name,
+        short reg,
+        short bit,
+        short invert
+    );
+
+    /** Reads a location of the simulated target.
+     * \param addr The address in the DataBuffer address space: program
+     *        memory, configuration memory from 0x2000, data EEPROM from
+     *        0x2100.
+     */
+    unsigned int get_word(unsigned long addr);
+
+    /** Writes a location of the simulated target directly, as a previous
+     * programming would have left it, see get_word().
+     */
+    void set_word(unsigned long addr, unsigned int value);
+
+private:
+    unsigned int *location(unsigned long addr, bool config);
+    void command(uint32_t command);
+    void begin_programming(void);
+    void erase_program_memory(bool config);
+
+    vector<unsigned int> program;   /* 0x2000 words */
+    vector<unsigned int> configmem; /* 0x2000 words, from 0x2000 */
+    vector<unsigned int> eeprom;    /* 256 bytes */
+
+    /* The write latches loaded since the last programming cycle */
+    vector<unsigned long> latch_addr;
+    vector<unsigned int> latch_data;
+    unsigned int ee_latch;
+    bool ee_loaded;
+
+    unsigned long pc;
+    bool pc_config;
+
+    uint32_t last_command;          /* The command waiting for its data */
+    bool erase_setup;               /* Bulk Erase Setup1/2 were given */
+    int erase_command;              /* The bulk erase waiting to begin */
+};
+
+#endif
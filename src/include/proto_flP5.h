@@ -20,6 +20,8 @@
 
 #include "Preferences.h"
 #include "HexFile.h"
+#include "HexCache.h"
+#include "GangProgrammer.h"
 #include "DataBuffer.h"
 #include "Device.h"
 #include "IO.h"
@@ -152,7 +154,6 @@ extern bool loadGeneralSettings(const char *fname);
 extern bool generalSettingsCB(CfgOper oper);
 extern void loadPreferences(void);
 extern bool cfgWordsCB(CfgOper oper);
-extern bool showMemoryDumpCB(void *data,const char *line,int progress);
 extern void dumpHexFile(bool set_wordsize);
 extern bool processOperation(ChipOper oper);
 extern void loadHexFile(void);
@@ -164,7 +165,7 @@ extern int currentDevice;
 extern int currentProgrammer;
 
 extern DataBuffer buf;
-extern HexFile *hexFile;
+extern HexCache hexCache;
 extern Device *chip;
 extern IO *io;
 
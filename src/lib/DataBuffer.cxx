@@ -30,6 +30,33 @@ DataBuffer::DataBuffer(int wordsize)
     memset(chunktable, 0, sizeof(chunktable));
 }
 
+DataBuffer::DataBuffer(const DataBuffer& other)
+{
+    memset(chunktable, 0, sizeof(chunktable));
+    *this = other;
+}
+
+DataBuffer& DataBuffer::operator=(const DataBuffer& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+    this->clear();
+    this->wordsize   = other.wordsize;
+    this->clearvalue = other.clearvalue;
+    for (int i=0; i < num_chunks; i++) {
+        if (other.chunktable[i] != NULL) {
+            chunktable[i] = new unsigned int[chunk_size];
+            memcpy (
+                chunktable[i],
+                other.chunktable[i],
+                chunk_size * sizeof(unsigned int)
+            );
+        }
+    }
+    return *this;
+}
+
 DataBuffer::~DataBuffer()
 {
     this->clear();
@@ -146,3 +173,11 @@ unsigned int *chunk;
     }
     return chunk[n % chunk_size];
 }
+
+const unsigned int *DataBuffer::get_chunk(long chunk_num)
+{
+    if ((chunk_num < 0) || (chunk_num >= num_chunks)) {
+        throw out_of_range("DataBuffer chunk out of range");
+    }
+    return chunktable[chunk_num];
+}
@@ -16,8 +16,16 @@
  *
  * $Id: Device.cxx,v 1.13 2002/11/06 22:42:37 marka Exp $
  */
+#include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <stdexcept>
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -25,21 +33,19 @@ using namespace std;
 #include "devices/Microchip/Microchip.h"
 #include "Util.h"
 
-Preferences *Device::config = NULL;
-
 Device *Device::load(Preferences *config, char *name)
 {
 Device *d = NULL;
-char *vendor, *spec;
+const DeviceSpec *spec = DeviceSpec::lookup(config, name);
+char *vendor, *family;
 
-    Device::config = config;
     vendor = name;
-    spec = strchr(name,'/');
-    if (spec) {
-        *spec='\0';
-        spec++;
+    family = strchr(name,'/');
+    if (family) {
+        *family='\0';
+        family++;
         if (strncasecmp(vendor,"Microchip",sizeof("Microchip")) == 0) { 
-            d = Microchip::load(spec);
+            d = Microchip::load(spec, family);
         } else {
             throw runtime_error (
                 (const char *)Preferences::Name (
@@ -59,14 +65,23 @@ char *vendor, *spec;
     return d;
 }
 
-Device::Device(char *name)
+Device::Device(const DeviceSpec *spec, char *name)
 {
+    this->spec = spec;
     this->wordsize = 8;
     this->set_iodevice(NULL);
     this->set_progress_cb(NULL);
     this->set_dump_cb(NULL);
     this->progress_count = 0;
     this->progress_total = 1;
+    this->set_trust_erase(false);
+    this->erased = false;
+    this->sparse_verify = false;
+    this->job_base = NULL;
+    this->mismatches = NULL;
+    this->in_session = false;
+    this->cells_written = 0;
+    this->cells_skipped = 0;
     this->name = string(name);
 }
 
@@ -80,58 +95,315 @@ void Device::dump(DataBuffer& buf)
         return;
     }
 
-int start, len, addr, bytes, data, i, j, buffer, area;
-bool writable, put_separator;
+DumpRowVector rows;
+char line[256], title[300];
+
+    this->dump_rows(buf, rows);
+    this->dump_cb(this->dump_cb_data,(const char *)0,-1);
+    for (DumpRowVector::iterator n = rows.begin(); n != rows.end(); n++) {
+        switch (n->kind) {
+            case DUMP_BLANK:
+                this->dump_cb(this->dump_cb_data,"",-1);
+            break;
+            case DUMP_TITLE:
+                this->dump_row(buf, *n, line, sizeof(line));
+                snprintf(title, sizeof(title), "@C255@_@b@C0%s", line);
+                this->dump_cb(this->dump_cb_data,title,-1);
+            break;
+            case DUMP_RULE:
+                this->dump_cb(this->dump_cb_data,"@-",-1);
+            break;
+            case DUMP_SPACE:
+                this->dump_cb(this->dump_cb_data,"@s",-1);
+            break;
+            default:
+                this->dump_row(buf, *n, line, sizeof(line));
+                this->dump_cb(this->dump_cb_data,(const char *)line,-1);
+            break;
+        }
+    }
+}
+
+/* The number of rows rendered at once by a listing thread */
+#define LISTING_SLICE_ROWS 4096
+
+/* A slice of the rows of a listing, see Device::write_listing() */
+typedef struct {
+    Device *chip;
+    DataBuffer *buf;
+    const DumpRow *rows;
+    size_t count;
+    string text;
+    string error;
+    bool started;
+#ifdef WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} ListingSlice;
+
+static int countProcessors(void)
+{
+#ifdef WIN32
+SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? count : 1;
+#endif
+}
+
+/* Renders a row of a listing. The rules underline the title before them,
+ * the spacers of the view are left out.
+ * \returns false if the row has no line. */
+static bool listingLine (
+    Device *chip,
+    DataBuffer& buf,
+    const DumpRow& row,
+    char *line,
+    size_t size
+) {
+DumpRow title;
+size_t length;
+
+    switch (row.kind) {
+        case DUMP_BLANK:
+            line[0] = '\0';
+        break;
+        case DUMP_RULE:
+            title = row;
+            title.kind = DUMP_TITLE;
+            chip->dump_row(buf, title, line, size);
+            length = strlen(line);
+            memset(line, '-', length);
+        break;
+        case DUMP_SPACE:
+            return false;
+        default:
+            chip->dump_row(buf, row, line, size);
+        break;
+    }
+    return true;
+}
+
+#ifdef WIN32
+static DWORD WINAPI renderSlice(LPVOID data)
+#else
+static void *renderSlice(void *data)
+#endif
+{
+ListingSlice *slice = (ListingSlice *)data;
+char line[256];
+
+    slice->text.erase();
+    try {
+        for (size_t i=0; i<slice->count; i++) {
+            if (
+                listingLine (
+                    slice->chip, *slice->buf, slice->rows[i],
+                    line, sizeof(line)
+                )
+            ) {
+                slice->text += line;
+                slice->text += '\n';
+            }
+        }
+    } catch (std::exception& e) {
+        slice->error = e.what();
+    }
+    return 0;
+}
+
+void Device::write_listing(DataBuffer& buf, FILE *out, int threads)
+{
+DumpRowVector rows;
+vector<ListingSlice> slices;
+size_t first, used, i;
+string error;
+
+    this->dump_rows(buf, rows);
+
+    if (threads <= 0) {
+        threads = countProcessors();
+    }
+    if ((size_t)threads > rows.size() / LISTING_SLICE_ROWS + 1) {
+        threads = rows.size() / LISTING_SLICE_ROWS + 1;
+    }
+
+    /* The first slice of each round is rendered by the calling thread.
+     * DataBuffer allocates its chunks on access: give each slice its own
+     * copy, which also leaves buf as it was */
+    slices.resize(threads);
+    for (i=0; i<slices.size(); i++) {
+        slices[i].chip    = this;
+        slices[i].buf     = new DataBuffer(buf);
+        slices[i].started = false;
+    }
+
+    for (first=0; first<rows.size() && error.empty(); ) {
+        for (used=0; used<slices.size() && first<rows.size(); used++) {
+            slices[used].rows  = &rows[first];
+            slices[used].count = rows.size() - first;
+            if (slices[used].count > LISTING_SLICE_ROWS) {
+                slices[used].count = LISTING_SLICE_ROWS;
+            }
+            first += slices[used].count;
+            if (used == 0) {
+                continue;
+            }
+#ifdef WIN32
+            slices[used].thread = CreateThread (
+                NULL, 0, renderSlice, &slices[used], 0, NULL
+            );
+            slices[used].started = (slices[used].thread != NULL);
+#else
+            slices[used].started = (
+                pthread_create (
+                    &slices[used].thread, NULL, renderSlice, &slices[used]
+                ) == 0
+            );
+#endif
+        }
+        /* The slices whose thread couldn't start are rendered here too */
+        for (i=0; i<used; i++) {
+            if (!slices[i].started) {
+                renderSlice(&slices[i]);
+            }
+        }
+        for (i=0; i<used; i++) {
+            if (slices[i].started) {
+#ifdef WIN32
+                WaitForSingleObject(slices[i].thread, INFINITE);
+                CloseHandle(slices[i].thread);
+#else
+                pthread_join(slices[i].thread, NULL);
+#endif
+                slices[i].started = false;
+            }
+            if (!error.empty()) {
+                continue;
+            }
+            if (!slices[i].error.empty()) {
+                error = slices[i].error;
+            } else if (
+                fwrite (
+                    slices[i].text.data(), 1, slices[i].text.size(), out
+                ) != slices[i].text.size()
+            ) {
+                error = "Can't write the listing";
+            }
+        }
+    }
+    for (i=0; i<slices.size(); i++) {
+        delete slices[i].buf;
+    }
+    if (error.empty() && fflush(out) != 0) {
+        error = "Can't write the listing";
+    }
+    if (!error.empty()) {
+        throw runtime_error(error);
+    }
+}
+
+void Device::add_row (
+    DumpRowVector& rows,
+    unsigned long addr,
+    int area,
+    DumpRowKind kind
+) {
+DumpRow row;
+
+    row.addr = addr;
+    row.area = area;
+    row.kind = kind;
+    rows.push_back(row);
+}
+
+void Device::dump_rows(DataBuffer& buf, DumpRowVector& rows)
+{
+unsigned long start, end, addr, i;
 int bufwordsize = ((buf.get_wordsize() + 7) & ~7) / 8;
-static char line[256], ascii[9];
+int words = (8 + bufwordsize - 1) / bufwordsize;
+bool writable, put_separator;
+int area;
 
 IntPairVector::iterator n = memmap.begin();
 
-    this->dump_cb(this->dump_cb_data,(const char *)0,-1);
+    rows.clear();
     for (area=0; n != memmap.end(); n++, area++) {
         start = n->first;
-        len   = n->second;
-        addr  = start;
+        end   = n->first + n->second;
         put_separator = true;
-        while (addr < (unsigned long)start+len) {
-            sprintf(line,"%07x)", addr);
-            writable=false;
-            for (i=0, bytes=0; bytes<8; bytes+=bufwordsize) {
-                if (area>0 || !buf.isblank(addr)) {
-                    writable=true;
-                }
-                if (addr < (unsigned long)start+len) {
-                    buffer = buf[addr];
-                    for (j=0; j<bufwordsize; j++) {
-                        data = buffer & 0xff;
-                        sprintf(line,"%s %02x", line, data);
-                        ascii[i++] = (isprint(data)) ? data : '.';
-                        buffer >>= 8;
-                    }
-                    addr++;
-                } else {
-                    for (j=0; j<bufwordsize; j++) {
-                        sprintf(line,"%s   ", line);
-                        ascii[i++] = ' ';
-                    }
-                }
+        for (addr=start; addr<end; addr+=words) {
+            writable = (area > 0);
+            for (i=addr; !writable && i<addr+words && i<end; i++) {
+                writable = !buf.isblank(i);
+            }
+            if (!writable) {
+                continue;
+            }
+            if (put_separator) {
+                add_row(rows, addr, area, DUMP_RULE);
+                add_row(rows, addr, area, DUMP_SPACE);
+                put_separator = false;
+            }
+            add_row(rows, addr, area, DUMP_DATA);
+        }
+    }
+}
+
+void Device::dump_row (
+    DataBuffer& buf,
+    const DumpRow& row,
+    char *line,
+    size_t size
+) {
+    if (row.kind == DUMP_DATA) {
+        this->dump_data_row(buf, row, row.addr, line, size);
+    } else if (size > 0) {
+        line[0] = '\0';
+    }
+}
+
+void Device::dump_data_row (
+    DataBuffer& buf,
+    const DumpRow& row,
+    unsigned long shown_addr,
+    char *line,
+    size_t size
+) {
+unsigned long addr, end;
+unsigned int buffer, data;
+int bufwordsize = ((buf.get_wordsize() + 7) & ~7) / 8;
+int bytes, i, j;
+char text[128], ascii[16], *p = text;
+
+    end = this->memmap[row.area].first + this->memmap[row.area].second;
+    p += sprintf(p, "%07lx)", shown_addr);
+    for (addr=row.addr, i=0, bytes=0; bytes<8; bytes+=bufwordsize) {
+        if (addr < end) {
+            buffer = buf[addr];
+            for (j=0; j<bufwordsize; j++) {
+                data = buffer & 0xff;
+                p += sprintf(p, " %02x", data);
+                ascii[i++] = (isprint(data)) ? data : '.';
+                buffer >>= 8;
             }
-            ascii[i] = '\0';
-            if (writable) {
-                if (put_separator) {
-                    this->dump_cb(this->dump_cb_data,"@-",-1);
-                    this->dump_cb(this->dump_cb_data,"@s",-1);
-                    put_separator = false;
-                }
-                sprintf(line,"%s |%s|", line, ascii);
-                this->dump_cb (
-                    this->dump_cb_data,
-                    (const char *)line,
-                    -1
-                );
+            addr++;
+        } else {
+            for (j=0; j<bufwordsize; j++) {
+                p += sprintf(p, "   ");
+                ascii[i++] = ' ';
             }
         }
     }
+    ascii[i] = '\0';
+    sprintf(p, " |%s|", ascii);
+    snprintf(line, size, "%s", text);
 }
 
 string Device::get_name(void)
@@ -186,3 +458,188 @@ void Device::set_dump_cb (
     this->dump_cb = cb;
     this->dump_cb_data = data;
 }
+
+void Device::reprogram(DataBuffer& buf, DataBuffer *)
+{
+IO::GangRead mode;
+
+    /* What the erase reads back (e.g. the calibration words) is kept, so
+     * it isn't a verify */
+    mode = this->gang_read(IO::GANG_READ_FIRST);
+    try {
+        this->erase();
+    } catch (std::exception& e) {
+        this->gang_read(mode);
+        throw;
+    }
+    this->gang_read(mode);
+    this->program(buf);
+}
+
+bool Device::can_skip_writes(void)
+{
+    return (this->io->gang_targets() <= 1);
+}
+
+IO::GangRead Device::gang_read(IO::GangRead mode)
+{
+IO::GangRead previous;
+
+    previous = this->io->gang_read();
+    this->io->gang_read(mode);
+
+    return previous;
+}
+
+void Device::set_trust_erase(bool enable, bool blank_check)
+{
+    this->trust_erase = enable;
+    this->trust_erase_check = blank_check;
+}
+
+void Device::run_job (
+    DataBuffer& buf,
+    JobStepVector& steps,
+    JobTimingVector& timings
+) {
+JobStepVector::iterator n;
+JobTiming timing;
+microtime_t start;
+
+    timings.clear();
+    this->in_session = true;
+    try {
+        for (n = steps.begin(); n != steps.end(); n++) {
+            start = this->io->now();
+            if (*n == JOB_CHECK || *n == JOB_ERASE) {
+                this->io->gang_read(IO::GANG_READ_FIRST);
+            } else {
+                this->io->gang_read(IO::GANG_READ_VERIFY);
+            }
+            switch (*n) {
+                case JOB_CHECK:
+                    this->check();
+                break;
+                case JOB_ERASE:
+                    this->erase();
+                break;
+                case JOB_BLANK_CHECK: {
+                    DataBuffer blank(buf.get_wordsize());
+
+                    this->set_config_default(blank);
+                    this->read(blank, true);
+                } break;
+                case JOB_PROGRAM:
+                    this->program(buf);
+                break;
+                case JOB_REPROGRAM:
+                    this->reprogram(buf, this->job_base);
+                break;
+                case JOB_VERIFY:
+                    this->read(buf, true);
+                break;
+            }
+            timing.step  = *n;
+            timing.usecs = this->io->now() - start;
+            timings.push_back(timing);
+        }
+    } catch (std::exception& e) {
+        this->io->gang_read(IO::GANG_READ_FIRST);
+        this->in_session = false;
+        this->end_session();
+        throw;
+    }
+    this->io->gang_read(IO::GANG_READ_FIRST);
+    this->in_session = false;
+    this->end_session();
+}
+
+void Device::end_session(void)
+{
+}
+
+bool Device::verify(DataBuffer& buf, MismatchVector& result)
+{
+IO::GangRead mode;
+
+    result.clear();
+    this->mismatches = &result;
+    mode = this->gang_read(IO::GANG_READ_VERIFY);
+    try {
+        this->read(buf, true);
+    } catch (std::exception& e) {
+        this->gang_read(mode);
+        this->mismatches = NULL;
+        throw;
+    }
+    this->gang_read(mode);
+    this->mismatches = NULL;
+
+    return result.empty();
+}
+
+bool Device::repair(DataBuffer& buf, MismatchVector& result)
+{
+MismatchVector failed;
+MismatchVector::iterator n;
+
+    if (result.empty()) {
+        return true;
+    }
+    /* What the device holds: the DataBuffer patched with the mismatches */
+    DataBuffer current(buf);
+    for (n = result.begin(); n != result.end(); n++) {
+        current[n->addr] &= ~n->mask;
+        current[n->addr] |= (n->actual & n->mask);
+    }
+    this->reprogram(buf, &current);
+
+    /* Read the device back and check the repaired locations again */
+    DataBuffer device(buf.get_wordsize());
+    this->read(device);
+    for (n = result.begin(); n != result.end(); n++) {
+        if ((device[n->addr] ^ buf[n->addr]) & n->mask) {
+            n->actual = device[n->addr] & n->mask;
+            failed.push_back(*n);
+        }
+    }
+    result = failed;
+
+    return result.empty();
+}
+
+bool Device::mismatch (
+    unsigned long addr,
+    unsigned int mask,
+    unsigned int expected,
+    unsigned int actual
+) {
+Mismatch m;
+
+    if (this->mismatches == NULL) {
+        return false;
+    }
+    m.addr     = addr;
+    m.mask     = mask;
+    m.expected = expected & mask;
+    m.actual   = actual & mask;
+    this->mismatches->push_back(m);
+
+    return true;
+}
+
+void Device::set_sparse_verify(bool enable)
+{
+    this->sparse_verify = enable;
+}
+
+void Device::set_job_base(DataBuffer *current)
+{
+    this->job_base = current;
+}
+
+void Device::get_cell_counts(unsigned long& written, unsigned long& skipped)
+{
+    written = this->cells_written;
+    skipped = this->cells_skipped;
+}
@@ -0,0 +1,538 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <map>
+
+#ifndef WIN32
+#  include <sys/mman.h>
+#endif
+
+using namespace std;
+
+#include "DeviceDB.h"
+
+#define DB_MAGIC        0x44355066UL /* "fP5D" */
+#define DB_VERSION      2
+
+#define FNV_OFFSET_BASIS 0x811c9dc5UL
+#define FNV_PRIME        0x01000193UL
+
+/* The hash index has a bucket every DB_BUCKET_LOAD names, and gives up
+ * looking for a bucket displacement after DB_MAX_DISPLACEMENT tries */
+#define DB_BUCKET_LOAD      4
+#define DB_MAX_DISPLACEMENT 0x100000UL
+
+/* A device while it is being compiled */
+typedef struct {
+    string path;
+    vector<pair<string, string> > entries;
+} SourceDevice;
+
+/* The strings of the database, each stored once */
+class StringPool
+{
+public:
+    uint32_t add(const string& s) {
+        map<string, uint32_t>::iterator n = index.find(s);
+        if (n != index.end()) {
+            return n->second;
+        }
+        uint32_t offset = data.size();
+        data.append(s.c_str(), s.size() + 1);
+        index[s] = offset;
+        return offset;
+    }
+    string data;
+private:
+    map<string, uint32_t> index;
+};
+
+DeviceDB::DeviceDB()
+{
+    this->image      = NULL;
+    this->image_size = 0;
+    this->mapped     = false;
+}
+
+DeviceDB::~DeviceDB()
+{
+    this->close();
+}
+
+uint32_t DeviceDB::hash(const char *name, uint32_t seed)
+{
+uint32_t h;
+
+    /* 32 bit FNV-1a, with a seed for the displacements */
+    h = FNV_OFFSET_BASIS ^ (seed * 0x9e3779b9UL);
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+void DeviceDB::compile(Preferences& devices, const char *filename)
+{
+vector<SourceDevice> source;
+vector<string> keys;
+vector<pair<string, uint32_t> > names;
+vector<vector<uint32_t> > bucket_names;
+vector<uint32_t> bucket_order, displacements, slots, taken;
+map<string, int> bare;
+StringPool pool;
+Header header;
+char value[1024];
+uint32_t b, d, i, j, s, num_fields;
+string temp;
+bool ok;
+FILE *fp;
+
+    /* Read the vendor/spec/device tree */
+    for (int vendor=0; vendor<devices.groups(); vendor++) {
+        Preferences vendors(devices, devices.group(vendor));
+        for (int spec=0; spec<vendors.groups(); spec++) {
+            Preferences specs(vendors, vendors.group(spec));
+            for (int device=0; device<specs.groups(); device++) {
+                Preferences dev(specs, specs.group(device));
+                SourceDevice sd;
+
+                sd.path  = devices.group(vendor);
+                sd.path += "/";
+                sd.path += vendors.group(spec);
+                sd.path += "/";
+                sd.path += specs.group(device);
+                for (int n=0; n<dev.entries(); n++) {
+                    dev.get(dev.entry(n), value, "", sizeof(value));
+                    sd.entries.push_back (
+                        pair<string, string>(dev.entry(n), value)
+                    );
+                    keys.push_back(dev.entry(n));
+                }
+                /* The fields are searched by key */
+                sort(sd.entries.begin(), sd.entries.end());
+                bare[specs.group(device)]++;
+                source.push_back(sd);
+            }
+        }
+    }
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+    /* Index the paths, and the device names which are unique */
+    for (i=0; i<source.size(); i++) {
+        names.push_back(pair<string, uint32_t>(source[i].path, i));
+        string name = source[i].path.substr(source[i].path.rfind('/') + 1);
+        if (bare[name] == 1) {
+            names.push_back(pair<string, uint32_t>(name, i));
+        }
+    }
+
+    /* Hash and displace: the names are spread into buckets, then each
+     * bucket, the largest first, gets the first displacement which moves
+     * all of its names to free slots */
+    header.names   = names.size();
+    header.buckets = names.size() / DB_BUCKET_LOAD + 1;
+    bucket_names.resize(header.buckets);
+    for (i=0; i<names.size(); i++) {
+        bucket_names[hash(names[i].first.c_str(), 0) % header.buckets]
+            .push_back(i);
+    }
+    for (b=0; b<header.buckets; b++) {
+        bucket_order.push_back((bucket_names[b].size() << 16) | b);
+    }
+    sort(bucket_order.rbegin(), bucket_order.rend());
+    displacements.assign(header.buckets, 0);
+    slots.assign(2 * header.names, 0);
+    taken.assign(header.names, 0);
+    for (i=0; i<bucket_order.size(); i++) {
+        b = bucket_order[i] & 0xffff;
+        if (bucket_names[b].empty()) {
+            break;
+        }
+        for (d=1; d<DB_MAX_DISPLACEMENT; d++) {
+            vector<uint32_t> tried;
+            for (j=0; j<bucket_names[b].size(); j++) {
+                s = hash(names[bucket_names[b][j]].first.c_str(), d) %
+                    header.names;
+                if (
+                    taken[s] ||
+                    std::find(tried.begin(), tried.end(), s) != tried.end()
+                ) {
+                    break;
+                }
+                tried.push_back(s);
+            }
+            if (j == bucket_names[b].size()) {
+                for (j=0; j<tried.size(); j++) {
+                    taken[tried[j]] = 1;
+                    slots[2*tried[j]]   =
+                        pool.add(names[bucket_names[b][j]].first);
+                    slots[2*tried[j]+1] = names[bucket_names[b][j]].second;
+                }
+                displacements[b] = d;
+                break;
+            }
+        }
+        if (d == DB_MAX_DISPLACEMENT) {
+            throw runtime_error("Couldn't build the device index.");
+        }
+    }
+
+    /* The fields: their text is parsed by DeviceSpec, as Preferences
+     * parses it */
+    vector<Field> fields;
+    vector<Record> records;
+    for (i=0; i<source.size(); i++) {
+        Record rec;
+
+        rec.path        = pool.add(source[i].path);
+        rec.first_field = fields.size();
+        rec.num_fields  = source[i].entries.size();
+        for (j=0; j<source[i].entries.size(); j++) {
+            const char *text = source[i].entries[j].second.c_str();
+            Field field;
+
+            field.key = lower_bound (
+                keys.begin(),
+                keys.end(),
+                source[i].entries[j].first
+            ) - keys.begin();
+            field.text = pool.add(text);
+            fields.push_back(field);
+        }
+        records.push_back(rec);
+    }
+    vector<uint32_t> key_names;
+    for (i=0; i<keys.size(); i++) {
+        key_names.push_back(pool.add(keys[i]));
+    }
+    num_fields = fields.size();
+
+    header.reserved    = 0;
+    header.magic       = DB_MAGIC;
+    header.version     = DB_VERSION;
+    header.devices     = records.size();
+    header.keys        = keys.size();
+    header.fields      = num_fields;
+    header.field_off   = sizeof(Header);
+    header.record_off  = header.field_off  + num_fields * sizeof(Field);
+    header.key_off     = header.record_off + records.size() * sizeof(Record);
+    header.bucket_off  = header.key_off    + keys.size() * sizeof(uint32_t);
+    header.slot_off    = header.bucket_off +
+                         header.buckets * sizeof(uint32_t);
+    header.string_off  = header.slot_off   + slots.size() * sizeof(uint32_t);
+    header.string_size = pool.data.size();
+    header.size        = header.string_off + header.string_size;
+
+    /* Write a temporary file, then replace the old one at once */
+    temp = string(filename) + ".tmp";
+    fp = fopen(temp.c_str(), "wb");
+    if (fp == NULL) {
+        throw runtime_error(strerror(errno));
+    }
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (ok && num_fields > 0) {
+        ok = fwrite(&fields[0], sizeof(Field), num_fields, fp) == num_fields;
+    }
+    if (ok && !records.empty()) {
+        ok = fwrite(&records[0], sizeof(Record), records.size(), fp) ==
+             records.size();
+    }
+    if (ok && !key_names.empty()) {
+        ok = fwrite(&key_names[0], sizeof(uint32_t), key_names.size(), fp) ==
+             key_names.size();
+    }
+    if (ok) {
+        ok = fwrite (
+            &displacements[0],
+            sizeof(uint32_t),
+            displacements.size(),
+            fp
+        ) == displacements.size();
+    }
+    if (ok && !slots.empty()) {
+        ok = fwrite(&slots[0], sizeof(uint32_t), slots.size(), fp) ==
+             slots.size();
+    }
+    if (ok && header.string_size > 0) {
+        ok = fwrite(pool.data.data(), 1, header.string_size, fp) ==
+             header.string_size;
+    }
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(temp.c_str(), filename) != 0) {
+        remove(temp.c_str());
+        throw runtime_error("Couldn't write the device database.");
+    }
+}
+
+bool DeviceDB::open(const char *filename)
+{
+struct stat st;
+FILE *fp;
+void *p;
+
+    this->close();
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    if (fstat(fileno(fp), &st) < 0 || st.st_size < (off_t)sizeof(Header)) {
+        fclose(fp);
+        return false;
+    }
+    this->image_size = st.st_size;
+
+#ifndef WIN32
+    /* Shared: all the processes mapping the file use the same pages */
+    p = mmap(NULL, this->image_size, PROT_READ, MAP_SHARED, fileno(fp), 0);
+    if (p != MAP_FAILED) {
+        this->image  = (const unsigned char *)p;
+        this->mapped = true;
+    } else
+#endif
+    {
+        /* No mapping available, fall back to read the whole file */
+        p = malloc(this->image_size);
+        if (p && fread(p, 1, this->image_size, fp) == this->image_size) {
+            this->image  = (const unsigned char *)p;
+            this->mapped = false;
+        } else {
+            free(p);
+        }
+    }
+    fclose(fp);
+
+    if (this->image == NULL) {
+        return false;
+    }
+    if (!this->check()) {
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+bool DeviceDB::check(void)
+{
+uint32_t i;
+
+    this->header = (const Header *)this->image;
+    if (
+        this->header->magic   != DB_MAGIC   ||
+        this->header->version != DB_VERSION ||
+        this->header->size    != this->image_size ||
+        this->header->names   == 0 ||
+        this->header->buckets == 0 ||
+        this->header->field_off  != sizeof(Header) ||
+        this->header->record_off != this->header->field_off +
+                                    this->header->fields * sizeof(Field) ||
+        this->header->key_off    != this->header->record_off +
+                                    this->header->devices * sizeof(Record) ||
+        this->header->bucket_off != this->header->key_off +
+                                    this->header->keys * sizeof(uint32_t) ||
+        this->header->slot_off   != this->header->bucket_off +
+                                    this->header->buckets * sizeof(uint32_t) ||
+        this->header->string_off != this->header->slot_off +
+                                    this->header->names * 2*sizeof(uint32_t) ||
+        this->header->size       != this->header->string_off +
+                                    this->header->string_size ||
+        this->header->string_size == 0 ||
+        this->image[this->image_size - 1] != '\0'
+    ) {
+        return false;
+    }
+    this->fields  = (const Field *)(this->image + this->header->field_off);
+    this->records = (const Record *)(this->image + this->header->record_off);
+    this->keys    = (const uint32_t *)(this->image + this->header->key_off);
+    this->buckets = (const uint32_t *)(this->image + this->header->bucket_off);
+    this->slots   = (const uint32_t *)(this->image + this->header->slot_off);
+    this->strings = (const char *)(this->image + this->header->string_off);
+
+    /* Every offset must stay inside its table */
+    for (i=0; i<this->header->devices; i++) {
+        if (
+            this->records[i].path >= this->header->string_size ||
+            this->records[i].first_field > this->header->fields ||
+            this->records[i].num_fields >
+                this->header->fields - this->records[i].first_field
+        ) {
+            return false;
+        }
+    }
+    for (i=0; i<this->header->fields; i++) {
+        if (
+            this->fields[i].key  >= this->header->keys ||
+            this->fields[i].text >= this->header->string_size
+        ) {
+            return false;
+        }
+    }
+    for (i=0; i<this->header->keys; i++) {
+        if (this->keys[i] >= this->header->string_size) {
+            return false;
+        }
+    }
+    for (i=0; i<this->header->names; i++) {
+        if (
+            this->slots[2*i]   >= this->header->string_size ||
+            this->slots[2*i+1] >= this->header->devices
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeviceDB::open_cached(Preferences& devices)
+{
+char path[1024];
+string prefs, db;
+struct stat prefs_st, db_st;
+size_t len;
+
+    /* The user data directory of the settings is named after their file:
+     * the database is kept there */
+    if (!devices.getUserdataPath(path, sizeof(path))) {
+        return false;
+    }
+    db  = string(path) + "devices.db";
+    len = strlen(path);
+    while (len > 0 && (path[len-1] == '/' || path[len-1] == '\\')) {
+        path[--len] = '\0';
+    }
+    prefs = string(path) + ".prefs";
+
+    if (
+        stat(db.c_str(), &db_st) == 0 &&
+        (stat(prefs.c_str(), &prefs_st) != 0 ||
+         db_st.st_mtime > prefs_st.st_mtime) &&
+        this->open(db.c_str())
+    ) {
+        return true;
+    }
+    try {
+        DeviceDB::compile(devices, db.c_str());
+    } catch (std::exception& e) {
+        return false;
+    }
+    return this->open(db.c_str());
+}
+
+void DeviceDB::close(void)
+{
+    if (this->image == NULL) {
+        return;
+    }
+#ifndef WIN32
+    if (this->mapped) {
+        munmap((void *)this->image, this->image_size);
+    } else
+#endif
+    {
+        free((void *)this->image);
+    }
+    this->image      = NULL;
+    this->image_size = 0;
+    this->mapped     = false;
+}
+
+unsigned int DeviceDB::get_devices(void)
+{
+    return (this->image) ? this->header->devices : 0;
+}
+
+const char *DeviceDB::get_path(unsigned int dev)
+{
+    return this->str(this->records[dev].path);
+}
+
+unsigned int DeviceDB::get_entries(unsigned int dev)
+{
+    return this->records[dev].num_fields;
+}
+
+const char *DeviceDB::get_entry(unsigned int dev, unsigned int entry)
+{
+const Field *field = this->fields + this->records[dev].first_field + entry;
+
+    return this->str(this->keys[field->key]);
+}
+
+const char *DeviceDB::get_text(unsigned int dev, unsigned int entry)
+{
+const Field *field = this->fields + this->records[dev].first_field + entry;
+
+    return this->str(field->text);
+}
+
+int DeviceDB::find(const char *name)
+{
+uint32_t b, s;
+
+    if (this->image == NULL) {
+        return -1;
+    }
+    b = hash(name, 0) % this->header->buckets;
+    s = hash(name, this->buckets[b]) % this->header->names;
+    if (strcmp(this->str(this->slots[2*s]), name) != 0) {
+        return -1;
+    }
+    return this->slots[2*s+1];
+}
+
+const DeviceDB::Field *DeviceDB::find_field(unsigned int dev, const char *key)
+{
+const Field *first, *last, *mid;
+int cmp;
+
+    /* The fields of a device are sorted by key */
+    first = this->fields + this->records[dev].first_field;
+    last  = first + this->records[dev].num_fields;
+    while (first < last) {
+        mid = first + (last - first) / 2;
+        cmp = strcmp(this->str(this->keys[mid->key]), key);
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    return NULL;
+}
+
+const char *DeviceDB::get(unsigned int dev, const char *key)
+{
+const Field *field = this->find_field(dev, key);
+
+    return (field) ? this->str(field->text) : NULL;
+}
@@ -0,0 +1,178 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+#include "DeviceSpec.h"
+
+/* The specs looked up so far, by path. The dropped ones are kept for the
+ * Device instances still using them. */
+static map<string, DeviceSpec *> registry;
+static vector<DeviceSpec *> retired;
+
+DeviceSpec::DeviceSpec(const char *path)
+{
+    this->path = path;
+}
+
+void DeviceSpec::add(const char *key, const char *text)
+{
+Entry entry;
+
+    entry.key    = key;
+    entry.text   = text;
+    entry.ivalue = atoi(text);
+    entry.dvalue = atof(text);
+    entry.hex    = (sscanf(text, "%x", (unsigned int *)&entry.hvalue) == 1);
+    if (!entry.hex) {
+        entry.hvalue = 0;
+    }
+    this->entries.push_back(entry);
+}
+
+bool DeviceSpec::less(const Entry& a, const Entry& b)
+{
+    return a.key < b.key;
+}
+
+const DeviceSpec::Entry *DeviceSpec::find(const char *key) const
+{
+int first, last, mid, cmp;
+
+    first = 0;
+    last  = this->entries.size();
+    while (first < last) {
+        mid = first + (last - first) / 2;
+        cmp = strcmp(this->entries[mid].key.c_str(), key);
+        if (cmp == 0) {
+            return &this->entries[mid];
+        } else if (cmp < 0) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    return NULL;
+}
+
+const DeviceSpec *DeviceSpec::registered(const char *path)
+{
+map<string, DeviceSpec *>::iterator n = registry.find(path);
+
+    return (n != registry.end()) ? n->second : NULL;
+}
+
+const DeviceSpec *DeviceSpec::enroll(DeviceSpec *spec)
+{
+    std::sort(spec->entries.begin(), spec->entries.end(), DeviceSpec::less);
+    registry[spec->path] = spec;
+
+    return spec;
+}
+
+const DeviceSpec *DeviceSpec::lookup(Preferences *config, const char *path)
+{
+const DeviceSpec *found = registered(path);
+DeviceSpec *spec;
+char *text;
+
+    if (found) {
+        return found;
+    }
+    spec = new DeviceSpec(path);
+    for (int i=0; i<config->entries(); i++) {
+        config->get(config->entry(i), text, "");
+        spec->add(config->entry(i), text);
+        free(text);
+    }
+    return enroll(spec);
+}
+
+const DeviceSpec *DeviceSpec::lookup(DeviceDB& db, unsigned int dev)
+{
+const DeviceSpec *found = registered(db.get_path(dev));
+DeviceSpec *spec;
+
+    if (found) {
+        return found;
+    }
+    spec = new DeviceSpec(db.get_path(dev));
+    for (unsigned int i=0; i<db.get_entries(dev); i++) {
+        spec->add(db.get_entry(dev, i), db.get_text(dev, i));
+    }
+    return enroll(spec);
+}
+
+void DeviceSpec::forget(const char *path)
+{
+map<string, DeviceSpec *>::iterator n;
+
+    for (n = registry.begin(); n != registry.end(); ) {
+        if (path == NULL || n->first == path) {
+            retired.push_back(n->second);
+            registry.erase(n++);
+        } else {
+            n++;
+        }
+    }
+}
+
+bool DeviceSpec::get(const char *key, int& value, int defaultValue) const
+{
+const Entry *entry = this->find(key);
+
+    value = (entry) ? entry->ivalue : defaultValue;
+    return entry != NULL;
+}
+
+bool DeviceSpec::get(const char *key, double& value, double defaultValue) const
+{
+const Entry *entry = this->find(key);
+
+    value = (entry) ? entry->dvalue : defaultValue;
+    return entry != NULL;
+}
+
+bool DeviceSpec::get (
+    const char *key,
+    char *value,
+    const char *defaultValue,
+    int maxSize
+) const {
+const Entry *entry = this->find(key);
+
+    strncpy(value, (entry) ? entry->text.c_str() : defaultValue, maxSize);
+    value[maxSize-1] = '\0';
+    return entry != NULL;
+}
+
+bool DeviceSpec::getHex(const char *key, int& value, int) const
+{
+const Entry *entry = this->find(key);
+
+    /* Like Preferences::getHex(), which parses the default value only when
+     * the entry is missing and then returns 0 anyway: the default value is
+     * never used */
+    value = (entry) ? entry->hvalue : 0;
+    return (entry != NULL) && entry->hex;
+}
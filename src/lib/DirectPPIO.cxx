@@ -43,13 +43,13 @@ DlPortDriver DirectPPIO::dlPortDriver;
 
 #endif
 
-DirectPPIO::DirectPPIO(int port) : ParallelPort(port)
+DirectPPIO::DirectPPIO(Preferences *config, int port) : ParallelPort(config, port)
 {
     if ((port > ports.count) || (port < 0) || !ports.address[port]) {
         throw runtime_error("Invalid DirectPP port number");
     }
 #ifdef WIN32
-static char str[20];
+char str[20];
 
     //Test if port is already in use
     sprintf(str,"LPT%d",port+1);
@@ -162,3 +162,13 @@ unsigned int val;
     }
     return val;
 }
+
+unsigned int DirectPPIO::get_register(char *, short reg)
+{
+    return inb(this->ioport + reg);
+}
+
+void DirectPPIO::set_register(char *, short reg, unsigned int value)
+{
+    outb(value, this->ioport + reg);
+}
@@ -0,0 +1,234 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+
+using namespace std;
+
+#include "GangProgrammer.h"
+
+GangProgrammer::GangProgrammer()
+{
+    this->started = 0;
+}
+
+GangProgrammer::~GangProgrammer()
+{
+    this->clear();
+}
+
+unsigned int GangProgrammer::add_slot (
+    Preferences *programmer,
+    char *method,
+    int port,
+    Preferences *devices,
+    char *device
+) {
+Slot *slot;
+char path[256];
+
+    slot = new Slot;
+    slot->port     = port;
+    slot->io       = NULL;
+    slot->chip     = NULL;
+    slot->buf      = NULL;
+    slot->state    = SLOT_IDLE;
+    slot->progress = 0;
+    slot->finished = 0;
+    slot->started  = false;
+
+    try {
+        /* Device::load() splits the path in place */
+        if (strlen(device) >= sizeof(path)) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Device path too long: %s",
+                    device
+                )
+            );
+        }
+        strcpy(path, device);
+        slot->io = IO::acquire(programmer, method, port);
+        slot->chip = Device::load(devices, path);
+        if (slot->chip == NULL) {
+            throw runtime_error (
+                (const char *)Preferences::Name("Unknown device %s", device)
+            );
+        }
+    } catch (std::exception& e) {
+        if (slot->io) {
+            delete slot->io;
+        }
+        delete slot;
+        throw;
+    }
+    slot->chip->set_iodevice(slot->io);
+    slot->chip->set_progress_cb(GangProgrammer::slot_progress, slot);
+
+    this->slots.push_back(slot);
+
+    return this->slots.size() - 1;
+}
+
+void GangProgrammer::clear(void)
+{
+    this->wait();
+
+    for (
+        vector<Slot *>::iterator n = this->slots.begin();
+        n != this->slots.end();
+        n++
+    ) {
+        delete (*n)->chip;
+        delete (*n)->io;
+        if ((*n)->buf) {
+            delete (*n)->buf;
+        }
+        delete *n;
+    }
+    this->slots.clear();
+}
+
+void GangProgrammer::start(DataBuffer& buf, JobStepVector& steps)
+{
+Slot *slot;
+
+    this->wait();
+
+    if (this->slots.empty()) {
+        return;
+    }
+    this->started = this->slots[0]->io->now();
+
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        slot = this->slots[i];
+
+        /* DataBuffer allocates its chunks on access: give each thread its
+         * own copy */
+        if (slot->buf) {
+            delete slot->buf;
+        }
+        slot->buf      = new DataBuffer(buf);
+        slot->steps    = steps;
+        slot->timings.clear();
+        slot->error    = "";
+        slot->progress = 0;
+        slot->finished = 0;
+        slot->state    = SLOT_RUNNING;
+
+#ifdef WIN32
+        slot->thread = CreateThread (
+            NULL, 0, GangProgrammer::run_slot, slot, 0, NULL
+        );
+        slot->started = (slot->thread != NULL);
+#else
+        slot->started = (
+            pthread_create (
+                &slot->thread, NULL, GangProgrammer::run_slot, slot
+            ) == 0
+        );
+#endif
+        if (!slot->started) {
+            slot->state = SLOT_FAILED;
+            slot->error = "Couldn't start the programming thread";
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Port %d: %s",
+                    slot->port,
+                    slot->error.c_str()
+                )
+            );
+        }
+    }
+}
+
+bool GangProgrammer::running(void)
+{
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        if (this->slots[i]->state == SLOT_RUNNING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GangProgrammer::wait(void)
+{
+Slot *slot;
+bool passed = true;
+
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        slot = this->slots[i];
+        if (slot->started) {
+#ifdef WIN32
+            WaitForSingleObject(slot->thread, INFINITE);
+            CloseHandle(slot->thread);
+#else
+            pthread_join(slot->thread, NULL);
+#endif
+            slot->started = false;
+        }
+        if (slot->state != SLOT_PASSED) {
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+microtime_t GangProgrammer::get_elapsed(void)
+{
+microtime_t last = this->started;
+
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        if (this->slots[i]->finished > last) {
+            last = this->slots[i]->finished;
+        }
+    }
+    return last - this->started;
+}
+
+#ifdef WIN32
+DWORD WINAPI GangProgrammer::run_slot(LPVOID data)
+#else
+void *GangProgrammer::run_slot(void *data)
+#endif
+{
+Slot *slot = (Slot *)data;
+
+    try {
+        slot->io->vdd(IO::VDD_TO_PRG);
+        slot->chip->run_job(*slot->buf, slot->steps, slot->timings);
+        slot->io->off();
+        slot->finished = slot->io->now();
+        slot->state = SLOT_PASSED;
+    } catch (std::exception& e) {
+        slot->io->off();
+        slot->error = e.what();
+        slot->finished = slot->io->now();
+        slot->state = SLOT_FAILED;
+    }
+    return 0;
+}
+
+bool GangProgrammer::slot_progress(void *data, long, int percent)
+{
+    ((Slot *)data)->progress = percent;
+
+    return true;
+}
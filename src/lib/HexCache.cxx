@@ -0,0 +1,304 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdexcept>
+
+using namespace std;
+
+#include "HexFile.h"
+#include "HexCache.h"
+
+/* The nanoseconds of the modification time, where the system has them */
+#if defined(WIN32)
+#  define ST_MTIME_NSEC(st) 0L
+#elif defined(__APPLE__)
+#  define ST_MTIME_NSEC(st) ((long)(st).st_mtimespec.tv_nsec)
+#else
+#  define ST_MTIME_NSEC(st) ((long)(st).st_mtim.tv_nsec)
+#endif
+
+/* The coarsest modification time resolution (FAT), in seconds */
+#define MTIME_TICK       2
+
+#define FNV_OFFSET_BASIS 0x811c9dc5UL
+#define FNV_PRIME        0x01000193UL
+
+/* On disk image: header, then (chunk number, chunk words) pairs */
+#define DISK_MAGIC       0x49355066UL /* "fP5I" */
+#define DISK_HEADER_SIZE 5
+
+HexCache::HexCache(unsigned int max_entries)
+{
+    this->max_entries = (max_entries > 0) ? max_entries : 1;
+    this->hits        = 0;
+    this->disk_hits   = 0;
+    this->misses      = 0;
+}
+
+HexCache::~HexCache()
+{
+    this->clear();
+}
+
+void HexCache::set_cache_dir(const char *dir)
+{
+    this->cache_dir = (dir) ? dir : "";
+}
+
+void HexCache::clear(void)
+{
+    for (
+        list<Entry>::iterator n = this->entries.begin();
+        n != this->entries.end();
+        n++
+    ) {
+        delete n->image;
+    }
+    this->entries.clear();
+}
+
+bool HexCache::load(const char *filename, DataBuffer& buf)
+{
+struct stat st;
+Entry entry;
+HexFile *hf;
+bool cached, hashed, same;
+
+    /* Before the file is read: see the checked member of Entry */
+    entry.checked = time(NULL);
+    if (stat(filename, &st) < 0) {
+        throw runtime_error(strerror(errno));
+    }
+    entry.path     = filename;
+    entry.size     = st.st_size;
+    entry.mtime    = st.st_mtime;
+    entry.mtime_ns = ST_MTIME_NSEC(st);
+    entry.hash     = 0;
+    entry.image    = NULL;
+    hashed         = false;
+
+    /* Look for the image in memory: an unchanged size and modification
+     * time are enough, unless the file was cached within the same
+     * modification time tick. Then it may have changed again without
+     * changing its mtime, and only the hash of the contents tells. */
+    for (
+        list<Entry>::iterator n = this->entries.begin();
+        n != this->entries.end();
+        n++
+    ) {
+        if (n->path != entry.path) {
+            continue;
+        }
+        same = (
+            n->size     == entry.size     &&
+            n->mtime    == entry.mtime    &&
+            n->mtime_ns == entry.mtime_ns &&
+            n->image->get_wordsize() == buf.get_wordsize()
+        );
+        if (same && n->checked <= n->mtime + MTIME_TICK) {
+            entry.hash = hash_file(filename);
+            hashed     = true;
+            same       = (entry.hash == n->hash);
+            n->checked = entry.checked;
+        }
+        if (same) {
+            /* Hit: move it in front of the list */
+            entry = *n;
+            this->entries.erase(n);
+            this->entries.push_front(entry);
+            buf = *entry.image;
+            this->hits++;
+            return true;
+        }
+        /* Stale image */
+        delete n->image;
+        this->entries.erase(n);
+        break;
+    }
+
+    /* The disk images are named after the contents */
+    if (!hashed) {
+        entry.hash = hash_file(filename);
+    }
+    entry.image = new DataBuffer(buf.get_wordsize());
+
+    cached = this->load_from_disk(entry);
+    if (cached) {
+        this->disk_hits++;
+    } else {
+        hf = NULL;
+        try {
+            hf = HexFile::load((char *)filename);
+            hf->read(*entry.image);
+        } catch (std::exception& e) {
+            if (hf) {
+                delete hf;
+            }
+            delete entry.image;
+            throw;
+        }
+        delete hf;
+        this->misses++;
+        this->save_to_disk(entry);
+    }
+
+    this->entries.push_front(entry);
+    while (this->entries.size() > this->max_entries) {
+        delete this->entries.back().image;
+        this->entries.pop_back();
+    }
+    buf = *entry.image;
+
+    return cached;
+}
+
+unsigned long HexCache::hash_file(const char *filename)
+{
+unsigned char data[65536];
+unsigned long hash;
+size_t i, len;
+FILE *fp;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        throw runtime_error(strerror(errno));
+    }
+    /* 32 bit FNV-1a */
+    hash = FNV_OFFSET_BASIS;
+    while ((len = fread(data, 1, sizeof(data), fp)) > 0) {
+        for (i=0; i<len; i++) {
+            hash ^= data[i];
+            hash  = (hash * FNV_PRIME) & 0xffffffffUL;
+        }
+    }
+    fclose(fp);
+
+    return hash;
+}
+
+string HexCache::disk_name(Entry& entry)
+{
+char name[64];
+
+    sprintf (
+        name,
+        "/%08lx%08lx-%02d.img",
+        entry.hash,
+        entry.size & 0xffffffffUL,
+        entry.image->get_wordsize()
+    );
+    return this->cache_dir + name;
+}
+
+bool HexCache::load_from_disk(Entry& entry)
+{
+unsigned int header[DISK_HEADER_SIZE];
+unsigned int chunk_num;
+bool ok = false;
+FILE *fp;
+
+    if (this->cache_dir.empty()) {
+        return false;
+    }
+    fp = fopen(this->disk_name(entry).c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    if (
+        fread(header, sizeof(header[0]), DISK_HEADER_SIZE, fp) ==
+            DISK_HEADER_SIZE &&
+        header[0] == DISK_MAGIC &&
+        header[1] == (unsigned int)entry.image->get_wordsize() &&
+        header[2] == (unsigned int)(entry.size & 0xffffffffUL) &&
+        header[3] == (unsigned int)entry.hash
+    ) {
+        ok = true;
+        for (unsigned int i=0; ok && i<header[4]; i++) {
+            ok = (fread(&chunk_num, sizeof(chunk_num), 1, fp) == 1) &&
+                 (chunk_num < DataBuffer::num_chunks);
+            if (ok) {
+                ok = fread (
+                    &(*entry.image)[chunk_num * DataBuffer::chunk_size],
+                    sizeof(unsigned int),
+                    DataBuffer::chunk_size,
+                    fp
+                ) == DataBuffer::chunk_size;
+            }
+        }
+    }
+    fclose(fp);
+    if (!ok) {
+        entry.image->clear();
+    }
+    return ok;
+}
+
+void HexCache::save_to_disk(Entry& entry)
+{
+unsigned int header[DISK_HEADER_SIZE];
+const unsigned int *chunk;
+string name, temp;
+bool ok;
+FILE *fp;
+
+    if (this->cache_dir.empty()) {
+        return;
+    }
+    name = this->disk_name(entry);
+    temp = name + ".tmp";
+
+    header[0] = DISK_MAGIC;
+    header[1] = entry.image->get_wordsize();
+    header[2] = entry.size & 0xffffffffUL;
+    header[3] = entry.hash;
+    header[4] = 0;
+    for (long i=0; i<DataBuffer::num_chunks; i++) {
+        if (entry.image->get_chunk(i) != NULL) {
+            header[4]++;
+        }
+    }
+    fp = fopen(temp.c_str(), "wb");
+    if (fp == NULL) {
+        /* The disk cache is only an optimization */
+        return;
+    }
+    ok = fwrite(header, sizeof(header[0]), DISK_HEADER_SIZE, fp) ==
+            DISK_HEADER_SIZE;
+    for (unsigned int i=0; ok && i<DataBuffer::num_chunks; i++) {
+        chunk = entry.image->get_chunk(i);
+        if (chunk != NULL) {
+            ok = (fwrite(&i, sizeof(i), 1, fp) == 1) &&
+                 (fwrite (
+                     chunk,
+                     sizeof(unsigned int),
+                     DataBuffer::chunk_size,
+                     fp
+                 ) == DataBuffer::chunk_size);
+        }
+    }
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(temp.c_str(), name.c_str()) != 0) {
+        remove(temp.c_str());
+    }
+}
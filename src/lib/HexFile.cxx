@@ -36,6 +36,19 @@ int i, len;
     if (fp == NULL) {
         throw runtime_error(strerror(errno));
     }
+    memset(buf, 0, sizeof(buf));
+    len = fread(buf, 1, 4, fp);
+    rewind(fp);
+
+    /* Detect the binary object file types */
+    if ((len == 4) && (memcmp(buf, "\177ELF", 4) == 0)) {
+        return new HexFile_elf(fp);
+    }
+    i = (buf[0] & 0xff) | ((buf[1] & 0xff) << 8);
+    if ((len >= 2) && ((i == 0x1234) || (i == 0x1240))) {
+        /* Microchip COFF v1/v2 */
+        return new HexFile_coff(fp);
+    }
     fgets(buf, sizeof(buf), fp);
 
     /* Detect the file type */
@@ -0,0 +1,98 @@
+/* Copyright (C) 2002  Mark Andrew Aikens <marka@desert.cx>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdio.h>
+#include <stdexcept>
+
+using namespace std;
+
+#include "HexFile.h"
+
+/* Microchip COFF file header layout (always little endian) */
+#define F_MAGIC         0x00
+#define F_NSCNS         0x02
+#define F_OPTHDR        0x10
+#define FILHDR_SIZE     0x14
+
+#define MICROCHIP_MAGIC_v1  0x1234
+#define MICROCHIP_MAGIC_v2  0x1240
+
+/* Optional header: offset of rom_width_bits in v1 and v2 */
+#define OPT_ROMWIDTH_v1 0x08
+#define OPT_ROMWIDTH_v2 0x0a
+
+/* Section header layout */
+#define S_PADDR         0x08
+#define S_SIZE          0x10
+#define S_SCNPTR        0x14
+#define S_FLAGS         0x24
+#define SCNHDR_SIZE     0x28
+
+/* Section flags */
+#define STYP_TEXT       0x0020
+#define STYP_DATA_ROM   0x0100
+
+HexFile_coff::HexFile_coff(FILE *fp)
+    : HexFile_obj(fp)
+{
+}
+
+void HexFile_coff::read(DataBuffer& buf)
+{
+unsigned int magic, nscns, opthdr, i, loaded;
+unsigned long romwidth, hdr, offset, size, addr;
+
+    this->map_image();
+
+    magic  = this->get16(F_MAGIC);
+    nscns  = this->get16(F_NSCNS);
+    opthdr = this->get16(F_OPTHDR);
+
+    /* The ROM width tells if section addresses are byte or word ones */
+    romwidth = 8;
+    if (opthdr > 0) {
+        romwidth = this->get32 (
+            FILHDR_SIZE +
+            ((magic == MICROCHIP_MAGIC_v2) ? OPT_ROMWIDTH_v2 : OPT_ROMWIDTH_v1)
+        );
+    }
+
+    loaded = 0;
+    for (i=0; i<nscns; i++) {
+        hdr = FILHDR_SIZE + opthdr + i * SCNHDR_SIZE;
+        if ((this->get32(hdr + S_FLAGS) & (STYP_TEXT|STYP_DATA_ROM)) == 0) {
+            continue;
+        }
+        addr   = this->get32(hdr + S_PADDR);
+        size   = this->get32(hdr + S_SIZE);
+        offset = this->get32(hdr + S_SCNPTR);
+        if ((size == 0) || (offset == 0)) {
+            continue;
+        }
+        if (!this->inside(offset, size)) {
+            throw runtime_error("Corrupted COFF file.");
+        }
+        if (romwidth > 8) {
+            /* Word addressed program memory */
+            addr *= 2;
+        }
+        this->store(buf, addr, this->image + offset, size);
+        loaded++;
+    }
+    if (loaded == 0) {
+        throw runtime_error("No loadable data in COFF file.");
+    }
+}
@@ -0,0 +1,148 @@
+/* Copyright (C) 2002  Mark Andrew Aikens <marka@desert.cx>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdio.h>
+#include <stdexcept>
+
+using namespace std;
+
+#include "HexFile.h"
+
+/* ELF32 identification and header layout */
+#define EI_CLASS        4
+#define EI_DATA         5
+#define ELFCLASS32      1
+#define ELFDATA2MSB     2
+
+#define E_PHOFF         0x1c
+#define E_SHOFF         0x20
+#define E_PHENTSIZE     0x2a
+#define E_PHNUM         0x2c
+#define E_SHENTSIZE     0x2e
+#define E_SHNUM         0x30
+#define ELF32_EHDR_SIZE 0x34
+
+/* ELF32 program header layout */
+#define P_TYPE          0x00
+#define P_OFFSET        0x04
+#define P_PADDR         0x0c
+#define P_FILESZ        0x10
+#define ELF32_PHDR_SIZE 0x20
+#define PT_LOAD         1
+
+/* ELF32 section header layout */
+#define SH_TYPE         0x04
+#define SH_FLAGS        0x08
+#define SH_ADDR         0x0c
+#define SH_OFFSET       0x10
+#define SH_SIZE         0x14
+#define ELF32_SHDR_SIZE 0x28
+#define SHT_PROGBITS    1
+#define SHF_ALLOC       2
+
+HexFile_elf::HexFile_elf(FILE *fp)
+    : HexFile_obj(fp)
+{
+}
+
+void HexFile_elf::read(DataBuffer& buf)
+{
+bool be;
+unsigned long phoff, shoff, entsize, offset, size, hdr;
+unsigned int phnum, shnum, i, loaded;
+
+    this->map_image();
+
+    if (!this->inside(0, ELF32_EHDR_SIZE)) {
+        throw runtime_error("Corrupted ELF file.");
+    }
+    if (this->image[EI_CLASS] != ELFCLASS32) {
+        throw runtime_error("Only 32 bit ELF files are supported.");
+    }
+    be = (this->image[EI_DATA] == ELFDATA2MSB);
+
+    loaded = 0;
+
+    /* Prefer the program headers: they carry the load (physical) address */
+    phoff   = this->get32(E_PHOFF, be);
+    phnum   = this->get16(E_PHNUM, be);
+    entsize = this->get16(E_PHENTSIZE, be);
+    if ((phoff != 0) && (phnum > 0)) {
+        if (entsize < ELF32_PHDR_SIZE) {
+            throw runtime_error("Corrupted ELF file.");
+        }
+        for (i=0; i<phnum; i++) {
+            hdr = phoff + i * entsize;
+            if (this->get32(hdr + P_TYPE, be) != PT_LOAD) {
+                continue;
+            }
+            offset = this->get32(hdr + P_OFFSET, be);
+            size   = this->get32(hdr + P_FILESZ, be);
+            if (size == 0) {
+                continue;
+            }
+            if (!this->inside(offset, size)) {
+                throw runtime_error("Corrupted ELF file.");
+            }
+            this->store (
+                buf,
+                this->get32(hdr + P_PADDR, be),
+                this->image + offset,
+                size
+            );
+            loaded++;
+        }
+    }
+    if (loaded > 0) {
+        return;
+    }
+
+    /* Relocatable objects: load the allocated sections */
+    shoff   = this->get32(E_SHOFF, be);
+    shnum   = this->get16(E_SHNUM, be);
+    entsize = this->get16(E_SHENTSIZE, be);
+    if ((shoff != 0) && (shnum > 0)) {
+        if (entsize < ELF32_SHDR_SIZE) {
+            throw runtime_error("Corrupted ELF file.");
+        }
+        for (i=0; i<shnum; i++) {
+            hdr = shoff + i * entsize;
+            if ((this->get32(hdr + SH_TYPE, be) != SHT_PROGBITS) ||
+                ((this->get32(hdr + SH_FLAGS, be) & SHF_ALLOC) == 0))
+            {
+                continue;
+            }
+            offset = this->get32(hdr + SH_OFFSET, be);
+            size   = this->get32(hdr + SH_SIZE, be);
+            if (size == 0) {
+                continue;
+            }
+            if (!this->inside(offset, size)) {
+                throw runtime_error("Corrupted ELF file.");
+            }
+            this->store (
+                buf,
+                this->get32(hdr + SH_ADDR, be),
+                this->image + offset,
+                size
+            );
+            loaded++;
+        }
+    }
+    if (loaded == 0) {
+        throw runtime_error("No loadable data in ELF file.");
+    }
+}
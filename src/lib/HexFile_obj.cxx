@@ -0,0 +1,189 @@
+/* Copyright (C) 2002  Mark Andrew Aikens <marka@desert.cx>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdexcept>
+
+#ifdef WIN32
+#  include <io.h>
+#  include <fcntl.h>
+#else
+#  include <sys/mman.h>
+#endif
+
+using namespace std;
+
+#include "HexFile.h"
+
+HexFile_obj::HexFile_obj(FILE *fp)
+    : HexFile(fp, HEXFILE_READ)
+{
+    this->image      = NULL;
+    this->image_size = 0;
+    this->mapped     = false;
+}
+
+HexFile_obj::~HexFile_obj(void)
+{
+    this->unmap_image();
+}
+
+void HexFile_obj::write(DataBuffer&, long, long)
+{
+    throw logic_error("Object files can't be written.");
+}
+
+void HexFile_obj::map_image(void)
+{
+struct stat st;
+void *p;
+
+    if (this->image != NULL) {
+        return;
+    }
+    if (fstat(fileno(this->fp), &st) < 0) {
+        throw runtime_error(strerror(errno));
+    }
+    if (st.st_size <= 0) {
+        throw runtime_error("Empty object file.");
+    }
+    this->image_size = st.st_size;
+
+#ifndef WIN32
+    p = mmap(NULL, this->image_size, PROT_READ, MAP_PRIVATE,
+             fileno(this->fp), 0);
+    if (p != MAP_FAILED) {
+        this->image  = (const unsigned char *)p;
+        this->mapped = true;
+        return;
+    }
+#else
+    _setmode(_fileno(this->fp), _O_BINARY);
+#endif
+    /* No mapping available, fall back to read the whole file */
+    p = malloc(this->image_size);
+    if (p == NULL) {
+        throw runtime_error(strerror(errno));
+    }
+    rewind(this->fp);
+    if (fread(p, 1, this->image_size, this->fp) != this->image_size) {
+        free(p);
+        throw runtime_error("Couldn't read the object file.");
+    }
+    this->image  = (const unsigned char *)p;
+    this->mapped = false;
+}
+
+void HexFile_obj::unmap_image(void)
+{
+    if (this->image == NULL) {
+        return;
+    }
+#ifndef WIN32
+    if (this->mapped) {
+        munmap((void *)this->image, this->image_size);
+    } else
+#endif
+    {
+        free((void *)this->image);
+    }
+    this->image      = NULL;
+    this->image_size = 0;
+    this->mapped     = false;
+}
+
+bool HexFile_obj::inside(unsigned long offset, unsigned long len)
+{
+    return (offset <= this->image_size) &&
+           (len <= this->image_size - offset);
+}
+
+unsigned int HexFile_obj::get16(unsigned long offset, bool big_endian)
+{
+const unsigned char *p = this->image + offset;
+
+    if (!this->inside(offset, 2)) {
+        throw runtime_error("Corrupted object file.");
+    }
+    if (big_endian) {
+        return (p[0] << 8) | p[1];
+    }
+    return p[0] | (p[1] << 8);
+}
+
+unsigned long HexFile_obj::get32(unsigned long offset, bool big_endian)
+{
+const unsigned char *p = this->image + offset;
+
+    if (!this->inside(offset, 4)) {
+        throw runtime_error("Corrupted object file.");
+    }
+    if (big_endian) {
+        return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+               ((unsigned long)p[2] <<  8) |  (unsigned long)p[3];
+    }
+    return  (unsigned long)p[0]        | ((unsigned long)p[1] <<  8) |
+           ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+void HexFile_obj::store (
+    DataBuffer& buf,
+    unsigned long addr,
+    const unsigned char *data,
+    unsigned long len
+)
+{
+int bufwordlen;
+
+    bufwordlen = (buf.get_wordsize() + 7) & ~7;
+    switch (bufwordlen) {
+        case 8:
+            while (len > 0) {
+                buf[addr++] = *data++;
+                len--;
+            }
+        break;
+        case 16:
+            if ((len > 0) && ((addr % 2) != 0)) {
+                /* Unaligned start: high byte of the word */
+                buf[addr/2] &= ~0xff00;
+                buf[addr/2] |= (*data++ << 8);
+                addr++;
+                len--;
+            }
+            while (len >= 2) {
+                /* Whole words */
+                buf[addr/2] &= ~0xffff;
+                buf[addr/2] |= data[0] | (data[1] << 8);
+                data += 2;
+                addr += 2;
+                len  -= 2;
+            }
+            if (len > 0) {
+                /* Unaligned end: low byte of the word */
+                buf[addr/2] &= ~0x00ff;
+                buf[addr/2] |= *data;
+            }
+        break;
+        default:
+            throw runtime_error("Unsupported data buffer word size.");
+    }
+}
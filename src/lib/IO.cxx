@@ -36,22 +36,24 @@ using namespace std;
 #endif
 
 #include "DirectPPIO.h"
-
-Preferences *IO::config = NULL;
+#include "SimIO.h"
+#include "Sim18IO.h"
 
 IO *IO::acquire(Preferences *cfg, char *name, int port)
 {
 IO *io;
 
-    IO::config = cfg;
-
 #if defined(linux) && defined(ENABLE_LINUX_PPDEV)
     if (strcasecmp(name, "LinuxPPDev") == 0) {
-        io = new LinuxPPDevIO(port);
+        io = new LinuxPPDevIO(cfg, port);
     } else
 #endif
     if (strcasecmp(name, "DirectPP") == 0) {
-        io = new DirectPPIO(port);
+        io = new DirectPPIO(cfg, port);
+    } else if (strcasecmp(name, "Simulated") == 0) {
+        io = new SimIO(cfg, port);
+    } else if (strcasecmp(name, "Simulated18") == 0) {
+        io = new Sim18IO(cfg, port);
     } else {
         throw runtime_error("Unknown IO driver selected");
     }
@@ -60,11 +62,12 @@ IO *io;
     return io;
 }
 
-IO::IO(int port)
+IO::IO(Preferences *config, int port)
 {
 long default_delay, additional_delay;
 struct signal_delays tmp_delays;
 
+    this->config  = config;
     production_   = false;
 
     /* Read the signal delay values */
@@ -205,6 +208,26 @@ struct timeval now, later;
 #endif
 }
 
+microtime_t IO::now(void)
+{
+#ifdef WIN32
+
+LARGE_INTEGER freq, count;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (microtime_t)((count.QuadPart * 1000000) / freq.QuadPart);
+
+#else
+
+struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (microtime_t)now.tv_sec * 1000000 + now.tv_usec;
+
+#endif
+}
+
 void IO::shift_bits_out (
     uint32_t bits,
     int numbits,
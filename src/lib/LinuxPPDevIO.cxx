@@ -39,7 +39,7 @@ using namespace std;
 #include "LinuxPPDevIO.h"
 
 
-LinuxPPDevIO::LinuxPPDevIO(int port) : ParallelPort(port)
+LinuxPPDevIO::LinuxPPDevIO(Preferences *config, int port) : ParallelPort(config, port)
 {
 struct stat fdata;
 char devname[20];
@@ -191,4 +191,69 @@ unsigned int parm, arg;
     return parm;
 }
 
+unsigned int LinuxPPDevIO::get_register(char *name, short reg)
+{
+int parm, arg;
+
+    switch (reg) {
+        case 0:
+            parm = PPRDATA;
+        break;
+        case 1:
+            parm = PPRSTATUS;
+        break;
+        case 2:
+            parm = PPRCONTROL;
+        break;
+        default:
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "getRegister(%s): unknown register",
+                    name
+                )
+            );
+        break;
+    }
+    if (ioctl(this->fd, parm, &arg) < 0) {
+        throw runtime_error (
+            (const char *)Preferences::Name (
+                "getRegister(%s): read",
+                name
+            )
+        );
+    }
+    return arg;
+}
+
+void LinuxPPDevIO::set_register(char *name, short reg, unsigned int value)
+{
+int parm, arg;
+
+    switch (reg) {
+        case 0:
+            parm = PPWDATA;
+        break;
+        case 2:
+            parm = PPWCONTROL;
+        break;
+        default:
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "setRegister(%s): unknown register",
+                    name
+                )
+            );
+        break;
+    }
+    arg = value;
+    if (ioctl(this->fd, parm, &arg) < 0) {
+        throw runtime_error (
+            (const char *)Preferences::Name (
+                "setRegister(%s): write",
+                name
+            )
+        );
+    }
+}
+
 #endif // linux
@@ -97,7 +97,7 @@ static char hw_invert[25] = {
     0, 0, 0, 0, 0, 0, 0, 0
 };
 
-ParallelPort::ParallelPort(int port) : IO(port)
+ParallelPort::ParallelPort(Preferences *config, int port) : IO(config, port)
 {
 char programmer[20];
 int vregs, val;
@@ -123,6 +123,8 @@ char *message = "Either none or at least two of:\n\n" \
     config->get("vppOffCond"        ,vppOffCond ,0);
     config->get("hasSAVddVppControl",val        ,0);
 
+    this->read_gang_pins();
+
     hasSAVddVppControl((val!=0));
  
     vregs = 0;
@@ -137,6 +139,75 @@ ParallelPort::~ParallelPort()
 {
 }
 
+void ParallelPort::read_gang_pins(void)
+{
+int pin, t;
+short reg[2];
+
+    this->gangTargets = 1;
+    this->gangBits    = 0;
+    this->gangFailed  = 0;
+    this->gangRead    = GANG_READ_FIRST;
+
+    this->gangDataOutBit   [0] = this->icspDataOutBit;
+    this->gangDataOutInvert[0] = this->icspDataOutInvert;
+    this->gangDataInBit    [0] = this->icspDataInBit;
+    this->gangDataInInvert [0] = this->icspDataInInvert;
+
+    /* The other targets share clock, Vpp and Vdd and have their own data
+     * pins, in the same registers of the first target ones */
+    for (t=1; t<MAX_GANG_TARGETS; t++) {
+        config->get(Preferences::Name("icspDataOut%d", t+1), pin, 0);
+        if (pin == 0) {
+            break;
+        }
+        this->gangDataOutInvert[t] = (pin < 0) ? 1 : 0;
+        pin = (pin < 0) ? -pin : pin;
+        if ((pin > 25) || (pin2reg[pin-1] == -1)) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Invalid value for configuration parameter "
+                    "icspDataOut%dPin",
+                    t+1
+                )
+            );
+        }
+        this->gangDataOutInvert[t] ^= hw_invert[pin-1];
+        this->gangDataOutBit   [t]  = pin2bit[pin-1];
+        reg[0] = pin2reg[pin-1];
+
+        config->get(Preferences::Name("icspDataIn%d", t+1), pin, 0);
+        this->gangDataInInvert[t] = (pin < 0) ? 1 : 0;
+        pin = (pin < 0) ? -pin : pin;
+        if ((pin == 0) || (pin > 25) || (pin2reg[pin-1] == -1)) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Invalid value for configuration parameter "
+                    "icspDataIn%dPin",
+                    t+1
+                )
+            );
+        }
+        this->gangDataInInvert[t] ^= hw_invert[pin-1];
+        this->gangDataInBit   [t]  = pin2bit[pin-1];
+        reg[1] = pin2reg[pin-1];
+
+        if (
+            (reg[0] != this->icspDataOutReg) ||
+            (reg[1] != this->icspDataInReg)
+        ) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "The data pins of the gang target %d must be in the "
+                    "registers of icspDataOut and icspDataIn",
+                    t+1
+                )
+            );
+        }
+    }
+    this->gangTargets = t;
+}
+
 void ParallelPort::clock(bool state)
 {
     SET_PIN_STATE(clk, "icspClock", icspClock);
@@ -144,12 +215,101 @@ void ParallelPort::clock(bool state)
     
 void ParallelPort::data(bool state)
 {
-    SET_PIN_STATE(data, "icspDataOut", icspDataOut);
+unsigned int val, old;
+int t;
+
+    if (this->gangTargets <= 1) {
+        SET_PIN_STATE(data, "icspDataOut", icspDataOut);
+        return;
+    }
+    /* Drive the data lines of all the targets with a single write */
+    old = val = this->get_register("icspDataOut", this->icspDataOutReg);
+    for (t=0; t<this->gangTargets; t++) {
+        if (state ^ (this->gangDataOutInvert[t] != 0)) {
+            val |= (1 << this->gangDataOutBit[t]);
+        } else {
+            val &= ~(1 << this->gangDataOutBit[t]);
+        }
+    }
+    this->set_register("icspDataOut", this->icspDataOutReg, val);
+    this->post_set_delay (
+        this->data_delays_,
+        ((old >> this->icspDataOutBit) & 0x01) ^ this->icspDataOutInvert,
+        state
+    );
 }  
 
 bool ParallelPort::data(void)
 {
-    return GET_PIN_STATE(data, "icspDataIn", icspDataIn);
+unsigned int val;
+int t;
+
+    if (this->gangTargets <= 1) {
+        return GET_PIN_STATE(data, "icspDataIn", icspDataIn);
+    }
+    /* Read the data lines of all the targets with a single read */
+    this->pre_read_delay(this->data_delays_);
+    val = this->get_register("icspDataIn", this->icspDataInReg);
+    this->gangBits = 0;
+    for (t=0; t<this->gangTargets; t++) {
+        if (((val >> this->gangDataInBit[t]) & 0x01) ^
+            this->gangDataInInvert[t]) {
+            this->gangBits |= (1 << t);
+        }
+    }
+    return this->gangBits & 0x01;
+}
+
+uint32_t ParallelPort::shift_bits_in (
+    int numbits,
+    microtime_t tdly,
+    microtime_t tlow
+) {
+uint32_t data[MAX_GANG_TARGETS], mask;
+int t;
+
+    if (this->gangTargets <= 1) {
+        return IO::shift_bits_in(numbits, tdly, tlow);
+    }
+    for (t=0; t<this->gangTargets; t++) {
+        data[t] = 0;
+    }
+    mask = 0x00000001;
+    this->data(true);
+    while (numbits > 0) {
+        this->clock(true);
+        this->usleep(tdly);
+        this->data();
+        for (t=0; t<this->gangTargets; t++) {
+            if (this->gangBits & (1 << t)) {
+                data[t] |= mask;
+            }
+        }
+        this->clock(false);
+        this->usleep(tlow);
+        mask <<= 1;
+        numbits--;
+    }
+    this->data(false);
+
+    switch (this->gangRead) {
+        case GANG_READ_VERIFY:
+            /* The device algorithm checks the first target only */
+            for (t=1; t<this->gangTargets; t++) {
+                if (data[t] != data[0]) {
+                    this->gangFailed |= (1 << t);
+                }
+            }
+        break;
+        case GANG_READ_ANY:
+            for (t=1; t<this->gangTargets; t++) {
+                data[0] |= data[t];
+            }
+        break;
+        default:
+        break;
+    }
+    return data[0];
 }
 
 void ParallelPort::vpp(VppMode mode)
@@ -0,0 +1,186 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+#include <stdexcept>
+
+using namespace std;
+
+#include "Preferences.h"
+#include "PatchTemplate.h"
+
+PatchTemplate::PatchTemplate(DataBuffer& base)
+{
+    this->base = &base;
+}
+
+unsigned int PatchTemplate::add_slot (
+    const char *name,
+    unsigned long addr,
+    unsigned int width,
+    PatchFormat format,
+    unsigned long start,
+    long step,
+    unsigned int bits,
+    unsigned int fill
+) {
+Slot slot;
+
+    if ((width == 0) || (bits == 0) || (bits > 16)) {
+        throw runtime_error (
+            (const char *)Preferences::Name("Invalid patch slot %s", name)
+        );
+    }
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        if (
+            (addr < this->slots[i].addr + this->slots[i].width) &&
+            (this->slots[i].addr < addr + width)
+        ) {
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Patch slot %s overlaps %s",
+                    name,
+                    this->slots[i].name.c_str()
+                )
+            );
+        }
+    }
+    slot.name   = name;
+    slot.addr   = addr;
+    slot.width  = width;
+    slot.format = format;
+    slot.value  = start;
+    slot.step   = step;
+    slot.bits   = bits;
+    slot.fill   = fill;
+    this->slots.push_back(slot);
+
+    return this->slots.size() - 1;
+}
+
+void PatchTemplate::set_value(unsigned int slot, unsigned long value)
+{
+    this->slots[slot].value = value;
+}
+
+void PatchTemplate::next(void)
+{
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        this->slots[i].value += this->slots[i].step;
+    }
+}
+
+void PatchTemplate::encode(Slot& slot, PatchCellVector& cells)
+{
+static const char hex[] = "0123456789ABCDEF";
+unsigned long value, digits, radix, cellmask;
+unsigned int i, cell, shift;
+PatchCell pc;
+bool fits;
+
+    value = slot.value;
+    cellmask = (1UL << slot.bits) - 1;
+
+    /* BCD: each decimal digit becomes a nibble, then stored as binary */
+    fits = true;
+    if (slot.format == PATCH_BCD) {
+        digits = 0;
+        for (shift=0; value > 0 && shift < 8*sizeof(digits); shift+=4) {
+            digits |= (value % 10) << shift;
+            value /= 10;
+        }
+        fits  = (value == 0);
+        value = digits;
+    }
+
+    for (i=0; i<slot.width; i++) {
+        switch (slot.format) {
+            case PATCH_ASCII_DEC:
+            case PATCH_ASCII_HEX:
+                radix = (slot.format == PATCH_ASCII_DEC) ? 10 : 16;
+                cell  = hex[value % radix];
+                value /= radix;
+            break;
+            default:
+                cell  = value & cellmask;
+                value = (slot.bits < 8*sizeof(value)) ? value >> slot.bits : 0;
+            break;
+        }
+        /* The big endian formats store the least significant part last */
+        pc.addr  = (slot.format == PATCH_BINARY_LE) ? slot.addr + i
+                                                   : slot.addr + slot.width-1-i;
+        pc.value = cell | slot.fill;
+        cells.push_back(pc);
+    }
+    if (!fits || value != 0) {
+        throw runtime_error (
+            (const char *)Preferences::Name (
+                "Value %lu doesn't fit in patch slot %s",
+                slot.value,
+                slot.name.c_str()
+            )
+        );
+    }
+}
+
+void PatchTemplate::make_overlay(PatchCellVector& cells)
+{
+    cells.clear();
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        this->encode(this->slots[i], cells);
+    }
+}
+
+void PatchTemplate::apply(DataBuffer& image)
+{
+PatchCellVector cells;
+unsigned int i;
+
+    this->make_overlay(cells);
+
+    /* Undo the previous unit, then store this one */
+    for (i=0; i<this->overlay.size(); i++) {
+        image[this->overlay[i].addr] = (*this->base)[this->overlay[i].addr];
+    }
+    for (i=0; i<cells.size(); i++) {
+        image[cells[i].addr] = cells[i].value;
+    }
+    this->overlay = cells;
+}
+
+string PatchTemplate::describe(void)
+{
+string result;
+char value[32];
+
+    for (unsigned int i=0; i<this->slots.size(); i++) {
+        switch (this->slots[i].format) {
+            case PATCH_BCD:
+            case PATCH_ASCII_DEC:
+                sprintf(value, "%lu", this->slots[i].value);
+            break;
+            default:
+                sprintf(value, "0x%lx", this->slots[i].value);
+            break;
+        }
+        if (i > 0) {
+            result += " ";
+        }
+        result += this->slots[i].name + "=" + value;
+    }
+    return result;
+}
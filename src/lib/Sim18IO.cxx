@@ -0,0 +1,229 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+
+using namespace std;
+
+#include "Sim18IO.h"
+
+/* The commands of the PIC18 serial programming protocol */
+#define SIM18_CORE_INSTRUCTION  0x00
+#define SIM18_SHIFT_OUT_TABLAT  0x02
+#define SIM18_TABLE_READ        0x08
+#define SIM18_TABLE_READ_PREINC 0x0b
+
+#define SIM18_NO_COMMAND        0xff
+
+/* The registers and EECON1 bits used to reach the data EEPROM */
+#define SIM18_EECON1            0xa6
+#define SIM18_EEDATA            0xa8
+#define SIM18_EEADR             0xa9
+#define SIM18_EEADRH            0xaa
+#define SIM18_TABLAT            0xf5
+
+#define SIM18_EECON1_RD         0x01
+#define SIM18_EECON1_WR         0x02
+#define SIM18_EECON1_WREN       0x04
+#define SIM18_EECON1_CFGS       0x40
+#define SIM18_EECON1_EEPGD      0x80
+
+Sim18IO::Sim18IO(Preferences *config, int port) : IO(config, port)
+{
+    this->eeprom.assign(0x400, 0xff);
+    this->vpp(VPP_TO_VIH);
+    this->reset_counters();
+}
+
+Sim18IO::~Sim18IO()
+{
+}
+
+void Sim18IO::clock(bool)
+{
+}
+
+void Sim18IO::data(bool)
+{
+}
+
+bool Sim18IO::data(void)
+{
+    return false;
+}
+
+void Sim18IO::vpp(VppMode mode)
+{
+    /* Raising Vpp enters program mode, with the program memory selected */
+    if (mode == VPP_TO_VIH) {
+        for (unsigned int i=0; i<256; i++) {
+            this->reg[i] = 0;
+        }
+        this->reg[SIM18_EECON1] = SIM18_EECON1_EEPGD;
+        this->w = 0;
+        this->last_command = SIM18_NO_COMMAND;
+    }
+}
+
+void Sim18IO::vdd(VddMode)
+{
+}
+
+void Sim18IO::usleep(microtime_t us)
+{
+    this->account(us);
+}
+
+bool Sim18IO::ee_selected(void)
+{
+    return (this->reg[SIM18_EECON1] &
+            (SIM18_EECON1_EEPGD | SIM18_EECON1_CFGS)) == 0;
+}
+
+void Sim18IO::account(microtime_t us)
+{
+    if (this->ee_selected()) {
+        this->time += us;
+    }
+}
+
+void Sim18IO::shift_bits_out (
+    uint32_t bits,
+    int numbits,
+    microtime_t tset,
+    microtime_t thold
+) {
+uint32_t command = this->last_command;
+
+    if (numbits < 0) {
+        numbits = -numbits;
+    }
+    this->account(numbits * (tset + thold));
+    if (this->ee_selected()) {
+        this->bits += numbits;
+        this->frames++;
+    }
+    if (command == SIM18_NO_COMMAND) {
+        /* The 4 bit command, or its first 3 bits when the programming
+         * algorithm holds the clock for the 4th one */
+        this->last_command = bits & 0x0f;
+        return;
+    }
+    if (
+        command == SIM18_SHIFT_OUT_TABLAT ||
+        (command >= SIM18_TABLE_READ && command <= SIM18_TABLE_READ_PREINC)
+    ) {
+        /* The 8 dummy bits before the data is shifted in */
+        return;
+    }
+    this->last_command = SIM18_NO_COMMAND;
+    if (command == SIM18_CORE_INSTRUCTION) {
+        this->execute(bits & 0xffff);
+    }
+}
+
+uint32_t Sim18IO::shift_bits_in(int numbits, microtime_t tdly, microtime_t tlow)
+{
+uint32_t command = this->last_command;
+
+    this->account(numbits * (tdly + tlow));
+    if (this->ee_selected()) {
+        this->bits += numbits;
+        this->frames++;
+    }
+    this->last_command = SIM18_NO_COMMAND;
+    if (command == SIM18_SHIFT_OUT_TABLAT) {
+        return this->reg[SIM18_TABLAT];
+    }
+    /* The program and configuration memory read blank */
+    return 0xff;
+}
+
+void Sim18IO::execute(uint32_t instruction)
+{
+unsigned int f = instruction & 0xff;
+unsigned int bit = 1 << ((instruction >> 9) & 0x07);
+unsigned int *eecon1 = &this->reg[SIM18_EECON1];
+unsigned long addr;
+
+    switch (instruction & 0xff00) {
+        case 0x0e00:                        /* movlw k */
+            this->w = f;
+        break;
+        case 0x6e00:                        /* movwf f */
+            this->reg[f] = this->w;
+        break;
+        case 0x5000:                        /* movf f, W */
+            this->w = this->reg[f];
+        break;
+        case 0x2a00:                        /* incf f */
+            this->reg[f] = (this->reg[f] + 1) & 0xff;
+        break;
+        default:
+            if ((instruction & 0xf000) == 0x8000) {         /* bsf f, b */
+                this->reg[f] |= bit;
+            } else if ((instruction & 0xf000) == 0x9000) {  /* bcf f, b */
+                this->reg[f] &= ~bit;
+            }
+        break;
+    }
+
+    /* A read or write of the selected data EEPROM byte completes at once */
+    if (
+        f != SIM18_EECON1 ||
+        (*eecon1 & (SIM18_EECON1_RD | SIM18_EECON1_WR)) == 0
+    ) {
+        return;
+    }
+    addr = (this->reg[SIM18_EEADR] | (this->reg[SIM18_EEADRH] << 8)) &
+           (this->eeprom.size() - 1);
+    if (this->ee_selected()) {
+        if (*eecon1 & SIM18_EECON1_RD) {
+            this->reg[SIM18_EEDATA] = this->eeprom[addr];
+        }
+        if ((*eecon1 & SIM18_EECON1_WR) && (*eecon1 & SIM18_EECON1_WREN)) {
+            this->eeprom[addr] = this->reg[SIM18_EEDATA];
+        }
+    }
+    *eecon1 &= ~(SIM18_EECON1_RD | SIM18_EECON1_WR);
+}
+
+unsigned int Sim18IO::get_byte(unsigned long addr)
+{
+    return this->eeprom[addr & (this->eeprom.size() - 1)];
+}
+
+void Sim18IO::set_byte(unsigned long addr, unsigned int value)
+{
+    this->eeprom[addr & (this->eeprom.size() - 1)] = value & 0xff;
+}
+
+void Sim18IO::reset_counters(void)
+{
+    this->bits   = 0;
+    this->frames = 0;
+    this->time   = 0;
+}
+
+void Sim18IO::set_pin_state(char *, short, short, short, bool)
+{
+}
+
+bool Sim18IO::get_pin_state(char *, short, short, short)
+{
+    return false;
+}
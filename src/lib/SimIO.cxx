@@ -0,0 +1,263 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <stdio.h>
+
+using namespace std;
+
+#include "SimIO.h"
+
+/* The commands of the mid-range serial programming protocol */
+#define SIM_LOAD_CONFIG      0x00
+#define SIM_ERASE_SETUP1     0x01
+#define SIM_LOAD_PROG_DATA   0x02
+#define SIM_LOAD_DATA_DATA   0x03
+#define SIM_READ_PROG_DATA   0x04
+#define SIM_READ_DATA_DATA   0x05
+#define SIM_INC_ADDRESS      0x06
+#define SIM_ERASE_SETUP2     0x07
+#define SIM_BEGIN_PROG       0x08
+#define SIM_ERASE_PROG_MEM   0x09
+#define SIM_ERASE_DATA_MEM   0x0b
+#define SIM_RESET_ADDRESS    0x16
+#define SIM_BEGIN_PROG_ONLY  0x18
+#define SIM_LOAD_PC_ADDRESS  0x1d
+#define SIM_CHIP_ERASE       0x1f
+
+#define SIM_NO_COMMAND       0xff
+
+SimIO::SimIO(Preferences *config, int port) : IO(config, port)
+{
+    this->program.assign(0x2000, 0x3fff);
+    this->configmem.assign(0x2000, 0x3fff);
+    this->eeprom.assign(0x100, 0xff);
+    this->ee_latch      = 0xff;
+    this->ee_loaded     = false;
+    this->pc            = 0;
+    this->pc_config     = false;
+    this->last_command  = SIM_NO_COMMAND;
+    this->erase_setup   = false;
+    this->erase_command = SIM_NO_COMMAND;
+}
+
+SimIO::~SimIO()
+{
+}
+
+void SimIO::clock(bool)
+{
+}
+
+void SimIO::data(bool)
+{
+}
+
+bool SimIO::data(void)
+{
+    return false;
+}
+
+void SimIO::vpp(VppMode mode)
+{
+    /* Raising Vpp enters program mode, at the start of program memory */
+    if (mode == VPP_TO_VIH) {
+        this->pc            = 0;
+        this->pc_config     = false;
+        this->last_command  = SIM_NO_COMMAND;
+        this->erase_setup   = false;
+        this->erase_command = SIM_NO_COMMAND;
+        this->ee_loaded     = false;
+        this->latch_addr.clear();
+        this->latch_data.clear();
+    }
+}
+
+void SimIO::vdd(VddMode)
+{
+}
+
+void SimIO::usleep(microtime_t)
+{
+}
+
+unsigned int *SimIO::location(unsigned long addr, bool config)
+{
+    if (config) {
+        return &this->configmem[(addr - 0x2000) & 0x1fff];
+    }
+    return &this->program[addr & 0x1fff];
+}
+
+void SimIO::shift_bits_out (
+    uint32_t bits,
+    int numbits,
+    microtime_t,
+    microtime_t
+) {
+uint32_t command = this->last_command;
+
+    if (numbits < 0) {
+        numbits = -numbits;
+    }
+    if (command == SIM_NO_COMMAND) {
+        this->command(bits & 0x3f);
+        return;
+    }
+    this->last_command = SIM_NO_COMMAND;
+    switch (command) {
+        case SIM_LOAD_CONFIG:
+            this->pc        = 0x2000;
+            this->pc_config = true;
+            this->latch_addr.push_back(this->pc);
+            this->latch_data.push_back((bits >> 1) & 0x3fff);
+        break;
+        case SIM_LOAD_PROG_DATA:
+            this->latch_addr.push_back(this->pc);
+            this->latch_data.push_back((bits >> 1) & 0x3fff);
+        break;
+        case SIM_LOAD_DATA_DATA:
+            this->ee_latch  = (bits >> 1) & 0xff;
+            this->ee_loaded = true;
+        break;
+        case SIM_LOAD_PC_ADDRESS:
+            bits = (bits >> 1) & 0x3fffff;
+            this->pc_config = (bits >= 0x8000);
+            this->pc = (this->pc_config) ? 0x2000 + (bits - 0x8000) : bits;
+        break;
+    }
+}
+
+uint32_t SimIO::shift_bits_in(int, microtime_t, microtime_t)
+{
+uint32_t command = this->last_command;
+
+    this->last_command = SIM_NO_COMMAND;
+    switch (command) {
+        case SIM_READ_PROG_DATA:
+            return *this->location(this->pc, this->pc_config) << 1;
+        case SIM_READ_DATA_DATA:
+            return this->eeprom[this->pc & 0xff] << 1;
+    }
+    return 0;
+}
+
+void SimIO::command(uint32_t command)
+{
+    switch (command) {
+        case SIM_LOAD_CONFIG:
+        case SIM_LOAD_PROG_DATA:
+        case SIM_LOAD_DATA_DATA:
+        case SIM_READ_PROG_DATA:
+        case SIM_READ_DATA_DATA:
+        case SIM_LOAD_PC_ADDRESS:
+            /* Followed by a data frame */
+            this->last_command = command;
+        break;
+        case SIM_INC_ADDRESS:
+            this->pc++;
+        break;
+        case SIM_RESET_ADDRESS:
+            this->pc        = 0;
+            this->pc_config = false;
+        break;
+        case SIM_ERASE_SETUP2:
+            /* Setup1 then Setup2 prepare a bulk erase of the memory
+             * selected by the last load */
+            this->erase_setup = true;
+        break;
+        case SIM_ERASE_PROG_MEM:
+        case SIM_ERASE_DATA_MEM:
+            this->erase_command = command;
+        break;
+        case SIM_BEGIN_PROG:
+        case SIM_BEGIN_PROG_ONLY:
+            this->begin_programming();
+        break;
+        case SIM_CHIP_ERASE:
+            this->erase_program_memory(true);
+            this->eeprom.assign(this->eeprom.size(), 0xff);
+        break;
+        default:
+        break;
+    }
+}
+
+void SimIO::begin_programming(void)
+{
+    if (this->erase_setup) {
+        if (this->ee_loaded) {
+            this->eeprom.assign(this->eeprom.size(), 0xff);
+        } else {
+            this->erase_program_memory(this->pc_config);
+        }
+    } else if (this->erase_command == SIM_ERASE_PROG_MEM) {
+        this->erase_program_memory(this->pc_config);
+    } else if (this->erase_command == SIM_ERASE_DATA_MEM) {
+        this->eeprom.assign(this->eeprom.size(), 0xff);
+    } else if (this->ee_loaded) {
+        this->eeprom[this->pc & 0xff] = this->ee_latch;
+    } else {
+        for (unsigned int i=0; i<this->latch_addr.size(); i++) {
+            *this->location(this->latch_addr[i], this->pc_config) =
+                this->latch_data[i];
+        }
+    }
+    this->latch_addr.clear();
+    this->latch_data.clear();
+    this->ee_loaded     = false;
+    this->erase_setup   = false;
+    this->erase_command = SIM_NO_COMMAND;
+}
+
+void SimIO::erase_program_memory(bool config)
+{
+    this->program.assign(this->program.size(), 0x3fff);
+    if (config) {
+        /* The ID locations and the configuration word, not the device ID */
+        for (unsigned long addr=0x2000; addr<0x2008; addr++) {
+            if ((addr != 0x2005) && (addr != 0x2006)) {
+                *this->location(addr, true) = 0x3fff;
+            }
+        }
+    }
+}
+
+unsigned int SimIO::get_word(unsigned long addr)
+{
+    if (addr >= 0x2100) {
+        return this->eeprom[(addr - 0x2100) & 0xff];
+    }
+    return *this->location(addr, addr >= 0x2000);
+}
+
+void SimIO::set_word(unsigned long addr, unsigned int value)
+{
+    if (addr >= 0x2100) {
+        this->eeprom[(addr - 0x2100) & 0xff] = value & 0xff;
+    } else {
+        *this->location(addr, addr >= 0x2000) = value & 0x3fff;
+    }
+}
+
+void SimIO::set_pin_state(char *, short, short, short, bool)
+{
+}
+
+bool SimIO::get_pin_state(char *, short, short, short)
+{
+    return false;
+}
@@ -23,23 +23,23 @@ using namespace std;
 #include "Microchip.h"
 #include "Util.h"
 
-Device *Microchip::load(char *name)
+Device *Microchip::load(const DeviceSpec *spec, char *name)
 {
 Device *d = NULL;
-char *spec, *device;
+char *family, *device;
 
-    spec = name;
+    family = name;
     device = strchr(name,'/');
     if (device) {
         *device='\0';
         device++;
-        if (strncasecmp(spec,"PIC",sizeof("PIC")) == 0) { 
-            d = Pic::load(device);
+        if (strncasecmp(family,"PIC",sizeof("PIC")) == 0) { 
+            d = Pic::load(spec, device);
         } else {
             throw runtime_error (
                 (const char *)Preferences::Name (
                     "Unknown Microchip family %s",
-                    spec
+                    family
                 )
             );
         }
@@ -50,7 +50,7 @@ char *spec, *device;
 }
 
 
-Microchip::Microchip(char *name) : Device(name)
+Microchip::Microchip(const DeviceSpec *spec, char *name) : Device(spec, name)
 {
 }
 
@@ -39,6 +39,9 @@ typedef pair<int, int> IntPair;         /**< A pair of integers */
                                              erase */
 #define PIC_HAS_DEVICEID   0x00000010   /**< PIC has a device ID that can be
                                              read by the programming software */
+#define PIC_FEATURE_LOAD_PC 0x00000020  /**< PIC has the Load PC Address and
+                                             Reset Address commands (enhanced
+                                             mid-range devices) */
 
 
 /** A Device implementation which implements a base class for Microchip's
@@ -51,15 +54,16 @@ public:
      * subclass to instantiate. This allows for efficient implementation of
      * different Microchip devices programming algorithms.
      *
+     * \param spec The description of the device, see Device::load().
      * \param name The name of the device (case sensitive).
      * \retval NULL if the device is unknown.
      * \retval Device An instance of a subclass of Device representing the
      *         device given by the name parameter.
      */
-    static Device *load(char *name);
+    static Device *load(const DeviceSpec *spec, char *name);
 
     /** Constructor */
-    Microchip(char *name);
+    Microchip(const DeviceSpec *spec, char *name);
 
     /** Destructor */
     ~Microchip();
@@ -123,6 +127,20 @@ public:
     const enum Instruction_Class type;
 };
 
+/** The ICSP timings of a PIC, in microseconds, named after the symbols of
+ * the programming specifications. They are read from the device settings
+ * (tPPDP, tHLD0, tDLY1, tDLY2, tDIS, tOFF, tEXIT); the erase and programming
+ * times are the \c eraseTime and \c progTime settings. */
+typedef struct {
+    unsigned int tppdp; /**< Vdd rise to Vpp rise, RB6 & RB7 held low */
+    unsigned int thld0; /**< Vpp rise to the first command */
+    unsigned int tdly1; /**< Delay after a command */
+    unsigned int tdly2; /**< Delay after a data word */
+    unsigned int tdis;  /**< High voltage discharge after programming */
+    unsigned int toff;  /**< Off time before entering program mode again */
+    unsigned int texit; /**< Wait after leaving program mode */
+} PicTiming;
+
 /** A Device implementation which implements a base class for Microchip's PIC
  * microcontrollers. These microcontrollers are programmed serially and have
  * a word size of 12, 14, or 16 bits. They come in memory configurations of
@@ -157,21 +175,29 @@ public:
      * to instantiate. This allows for efficient implementation of different
      * PIC programming algorithms.
      *
+     * \param spec The description of the device, see Device::load().
      * \param name The name of the device (case sensitive).
      * \retval NULL if the device is unknown.
      * \retval Device An instance of a subclass of Device representing the
      *         device given by the name parameter.
      */
-    static Device *load(char *name);
+    static Device *load(const DeviceSpec *spec, char *name);
 
-    /** Dumps/disassemblates the contents of the DataBuffer.
-     * \param buf The DataBuffer containing the data to dump/disassemblate.
-     * \throws runtime_error Contains a textual description of the error.
-     */
-    virtual void dump(DataBuffer& buf);
+    /** Lists the rows of the dump: the non blank program words, one per
+     * row, and the other areas 8 bytes per row, each area under its
+     * title. */
+    virtual void dump_rows(DataBuffer& buf, DumpRowVector& rows);
+
+    /** Renders a row of the dump, disassembling the program words. */
+    virtual void dump_row (
+        DataBuffer& buf,
+        const DumpRow& row,
+        char *line,
+        size_t size
+    );
 
     /** Constructor */
-    Pic(char *name);
+    Pic(const DeviceSpec *spec, char *name);
 
     /** Destructor */
     ~Pic();
@@ -181,6 +207,12 @@ public:
 protected:
     int mem2asm(int org, DataBuffer& buf, char *buffer, size_t sizeof_buffer);
 
+    /** Gets the number of words of the instruction at an address without
+     * disassembling it.
+     * \returns The value mem2asm() would return.
+     */
+    int insn_words(int org, DataBuffer& buf);
+
     /** Perform a single program cycle for program memory. The following steps
      * are performed:
      *   - The data is written to the PIC with write_prog_data().
@@ -201,15 +233,27 @@ protected:
 
     /** Put the PIC device in program/verify mode. On entry to
      * program/verify mode, the program counter is set to 0 or -1 depending
-     * on the device.
+     * on the device. Nothing is done if the PIC has been kept in program
+     * mode by the previous step of a job.
      */
     virtual void set_program_mode(void);
 
     /** Turn off the PIC device. This will set the clock and data lines to
-     * low and shut off both Vpp and Vcc.
+     * low and shut off both Vpp and Vcc. Within a job, devices which can
+     * keep program mode (see keep_program_mode()) are left on instead.
      */
     virtual void pic_off(void);
 
+    /** Tells if the PIC can stay in program mode between the steps of a
+     * job. Devices which can reset their address pointers only by entering
+     * program mode again (e.g. the 14-bit PICs' program counter) return
+     * false, which is the default.
+     */
+    virtual bool keep_program_mode(void);
+
+    /** Turns off the PIC kept in program mode by a job. */
+    virtual void end_session(void);
+
     /** Write a 6 bit command to the PIC. After the write, a 1us delay is
      * performed as required by the device.
      * \param command The 6 bit command to write.
@@ -288,6 +332,25 @@ protected:
     unsigned int erase_buffer_size;
 
     const Instruction *popcodes;
+
+    /** Maps each 16 bit opcode word to its index in popcodes, or to 0xff
+     * if it isn't an instruction, see decoder(). */
+    const unsigned char *pdecode;
+
+    /** Gets the decode table of an instruction set, building it the first
+     * time. The table is shared by all the instances using the same
+     * instruction set.
+     * \param opcodes The instruction set, at most 255 instructions ending
+     *        with a NULL name. When several instructions match a word, the
+     *        first one wins.
+     */
+    static const unsigned char *decoder(const Instruction *opcodes);
+
+    /** The ICSP timings of this PIC. */
+    PicTiming timing;
+
+    /** True while the PIC is powered in program/verify mode. */
+    bool program_mode;
 };
 
 
@@ -296,15 +359,23 @@ protected:
 class Pic16 : public Pic
 {
 public:
+    /* Enhanced mid-range PIC commands */
+    // const static int
+    enum Enhanced_Commands_List {
+        COMMAND_RESET_ADDRESS   = 0x16, /**< Reset Address to 0          */
+        COMMAND_LOAD_PC_ADDRESS = 0x1d  /**< Load PC Address             */
+    };
+
     /** Create a new instance and read in in the configuration for the PIC
      * device. This constructor is called from Device::load() when the device
      * name begins with the string "PIC". This function will open the PIC
      * device configuration file "pic.conf" and read the configuration for
      * the device specified.
+     * \param spec The description of the device, see Device::load().
      * \param name The name of the PIC device.
      * \throws runtime_error Contains a description of the error.
      */
-    Pic16(char *name);
+    Pic16(const DeviceSpec *spec, char *name);
 
     /** Destructor */
     ~Pic16();
@@ -313,6 +384,18 @@ public:
     virtual void program(DataBuffer& buf);
     virtual void read(DataBuffer& buf, bool verify=false);
 
+    /** Program again the program memory locations which failed a verify
+     * with program_one_location(), which also works on EPROM devices, and
+     * rewrite the data EEPROM bytes which differ. The ID and configuration
+     * words aren't repaired.
+     * \param buf The DataBuffer containing the data to program.
+     * \param result The mismatches found by verify(). On return it holds
+     *        the ones which couldn't be repaired.
+     * \returns true if all the mismatches have been repaired.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    virtual bool repair(DataBuffer& buf, MismatchVector& result);
+
     /** Gets the native clearvalue depending on the memory address
      * \returns The clearvalue.
      */
@@ -367,13 +450,77 @@ protected:
     virtual void read_program_memory(DataBuffer& buf, long base=0,
       bool verify=false);
 
+    /** Program the entire contents of program memory using the write
+     * latches, \c prog_row_size words at a time, then verify it. Rows which
+     * are completely blank are skipped.
+     * \param buf A DataBuffer containing the data to program.
+     * \param base The offset within the data buffer to start retrieving data.
+     * \pre The PIC should have it's program counter set to the beginning of
+     *      program memory.
+     * \post The program counter is pointing to the address immediately after
+     *       the last program memory address.
+     * \throws runtime_error Contains a description of the error along with
+     *         the address at which the error occurred.
+     */
+    virtual void write_program_rows(DataBuffer& buf, long base=0);
+
+    /** Load a row of words in the write latches and program them. If all the
+     * words are blank, the row is just skipped: write_program_rows() reads
+     * it back, unless the erase is trusted (see trusted_erase()).
+     * \param buf A DataBuffer containing the data to program.
+     * \param base The offset within the data buffer of the first word.
+     * \param count The number of words in the row.
+     * \pre The PIC program counter points to the first word of the row.
+     * \post The PIC program counter points to the first word of the next
+     *       row.
+     */
+    virtual void program_row(DataBuffer& buf, long base, unsigned int count);
+
+    /** Program the words loaded in the write latches. The default sends
+     * BEGIN_PROG, waits \c program_time and, if the PIC requires it, sends
+     * END_PROG.
+     */
+    virtual void program_row_cycle(void);
+
+    /** Bring the program counter back to the beginning of program memory,
+     * so the written rows can be verified. The default uses set_pc(), which
+     * sends a Reset Address on the enhanced mid-range devices and
+     * re-enters program mode on the others.
+     */
+    virtual void rewind_program_memory(void);
+
+    /** Checks that the program memory locations which are blank in the
+     * DataBuffer are blank in the PIC device too. This is the final pass of
+     * the "trust erase" programming mode.
+     * \param buf A DataBuffer containing the programmed data.
+     * \param base The offset within the data buffer to start retrieving data.
+     * \pre The PIC should have it's program counter set to the beginning of
+     *      program memory.
+     * \post The program counter is pointing to the address immediatly after
+     *       the last program memory address.
+     * \throws runtime_error Contains a description of the error along with
+     *         the address at which the error occurred.
+     */
+    virtual void blank_check_program_memory(DataBuffer& buf, long base=0);
+
+    /** Tells if the blank locations can be skipped without reading them
+     * back, because the flash device has just been erased and the "trust
+     * erase" mode is enabled.
+     */
+    bool trusted_erase(void);
+
     /** Program the data EEPROM contents to the PIC device.
      * \param buf A DataBuffer containing the data to program.
      * \param base The offset within the data buffer to start retrieving data.
+     * Each byte is read first: the bytes already holding the value are
+     * neither written nor verified again.
      * \throws runtime_error Contains a description of the error along with
      *         the address at which the error occurred.
      */
-    virtual void write_data_memory(DataBuffer& buf, long base);
+    virtual void write_data_memory (
+        DataBuffer& buf,
+        long base
+    );
 
     /** Read the data EEPROM contents from the PIC device.
      * \param buf A DataBuffer in which to store the read data.
@@ -466,7 +613,65 @@ protected:
 
     virtual uint32_t read_deviceid(void);
 
+    /** Puts the PIC in program mode, resetting the tracked program counter
+     * since the PIC has been reset. */
+    virtual void set_program_mode(void);
+
+    /** Writes a 6 bit command to the PIC, keeping track of the commands
+     * which move the program counter: INC_ADDRESS, LOAD_CONFIG and, on the
+     * enhanced mid-range devices, RESET_ADDRESS.
+     * \param command The 6 bit command to write.
+     */
+    virtual void write_command(uint32_t command);
+
+    /** Moves the PIC program counter to an address, choosing the cheapest
+     * way to get there. Forward moves within the same memory space are done
+     * with INC_ADDRESS commands, unless the device supports Load PC Address
+     * and the distance is longer than \c PIC16_LOAD_PC_COST increments. The
+     * configuration memory is entered with LOAD_CONFIG. Moving back, or from
+     * the configuration memory back to the program memory, requires a Load
+     * PC Address or entering program mode again.
+     * \param addr The address in the DataBuffer address space: 0x2000 and
+     *        above is always the configuration memory, use set_pc_end()
+     *        for the end of a program memory of 0x2000 words.
+     * \pre The PIC is in program mode.
+     */
+    virtual void set_pc(unsigned long addr);
+
+    /** Moves the PIC program counter after the last program memory word,
+     * where a pass over the whole program memory leaves it.
+     * \pre The PIC is in program mode.
+     */
+    void set_pc_end(void);
+
+    /** Moves the PIC program counter to an address of a memory space, see
+     * set_pc().
+     * \param addr The address in the DataBuffer address space.
+     * \param config True for the configuration memory space.
+     */
+    void move_pc(unsigned long addr, bool config);
+
+    /** Loads the program counter with the Load PC Address command of the
+     * enhanced mid-range devices. The configuration memory addresses are
+     * translated to \c config_base.
+     * \param addr The address in the DataBuffer address space.
+     * \param config True for the configuration memory space.
+     */
+    virtual void load_pc_address(unsigned long addr, bool config);
+
 /* Protected data: */
+    /** The value of the PIC program counter, as far as the commands sent
+     * tell. In the configuration memory it's the DataBuffer address. */
+    unsigned long pc;
+
+    /** True if the program counter is in the configuration memory. */
+    bool pc_config;
+
+    /** The address of the configuration memory in the device address
+     * space: 0x2000 for the mid-range, 0x8000 for the enhanced mid-range
+     * devices. */
+    unsigned long config_base;
+
     /** The default value of the configuration bits after an erase */
     unsigned int default_config_word[2];
 
@@ -482,6 +687,10 @@ protected:
     /** Data protection bits. */
     unsigned int cpd_mask, cpd_on, cpd_off;
 
+    /** Number of program memory words loaded in the write latches and
+     * programmed together. 1 if the device writes a word at a time. */
+    unsigned int prog_row_size;
+
     static const Instruction opcodes[];
 };
 
@@ -508,38 +717,52 @@ public:
         COMMAND_BEGIN_PROG_EXT = 0x18  /**< Begin Programming, ext timing */
     };
 
-    Pic16f88x(char *name);    /**< Constructor */
+    Pic16f88x(const DeviceSpec *spec, char *name);    /**< Constructor */
     ~Pic16f88x();             /**< Destructor */
 
+    /** Reprogram the device erasing (ERASE_PROG_ROW) and writing only the
+     * 16 word program memory rows which changed. The data EEPROM bytes, ID
+     * and configuration words are written only if they changed. If an ID
+     * or configuration bit needs to be set, or the device is protected,
+     * the whole device is erased and programmed instead.
+     * \param buf The DataBuffer containing the data to program.
+     * \param current The current contents of the device, or NULL to read
+     *        them from the device.
+     */
+    virtual void reprogram(DataBuffer& buf, DataBuffer *current=NULL);
+
+    /** Program again the rows holding a mismatch, see reprogram(). A bit
+     * which has to go from 0 to 1 is repaired too, as the row is erased.
+     * \param buf The DataBuffer containing the data to program.
+     * \param result The mismatches found by verify().
+     * \returns true if all the mismatches have been repaired.
+     * \throws runtime_error Contains a textual description of the error.
+     */
+    virtual bool repair(DataBuffer& buf, MismatchVector& result);
+
 protected:
 	virtual void	erase(void);
 
-    /** Program the entire contents of program memory to the PIC device.
-     * \param buf A DataBuffer containing the data to program.
-     * \param base The offset within the data buffer to start retrieving data.
-     *        If this parameter isn't specified, it defaults to 0.
-     * \pre The PIC should have it's program counter set to the beginning of
-     *      program memory.
-     * \post The program counter is pointing to the address immediately after
-     *       the last program memory address.
-     * \throws runtime_error Contains a description of the error along with
-     *         the address at which the error occurred.
-     */
-    virtual void write_program_memory(DataBuffer& buf, long base=0);
+    /** Program the 4 or 8 loaded write latches, with the extended timing
+     * and the discharge time if the PIC requires END_PROG. */
+    virtual void program_row_cycle(void);
+
+    /** The program counter aliases to 0 after the last program memory
+     * address, so there's no need to leave program mode. */
+    virtual void rewind_program_memory(void);
 
-    /* Implement 4- or 8- word algorithm for program memory.  Program 4 or 8
-     * words at the current PC location.  PC is assumed to be 0 modulo 4 or 8,
-     * depending on the value of write_buffer_size.  Afterward, the PC has
-     * been advanced to the next 4 or 8 word boundary.	*/
-	virtual void program_mult_prog_loc(DataBuffer& buf, long base);
-	
     /** Program the data EEPROM contents to the PIC device.
      * \param buf A DataBuffer containing the data to program.
      * \param base The offset within the data buffer to start retrieving data.
+     * Each byte is read first: the bytes already holding the value are
+     * neither written nor verified again.
      * \throws runtime_error Contains a description of the error along with
      *         the address at which the error occurred.
      */
-	virtual void write_data_memory(DataBuffer& buf, long base=0x2100);
+	virtual void write_data_memory (
+        DataBuffer& buf,
+        long base=0x2100
+    );
 	
     /** Perform a single program cycle for program memory. The following steps
      * are performed:
@@ -566,7 +789,7 @@ protected:
 class Pic16f8xx : public Pic16
 {
 public:
-    Pic16f8xx(char *name);    /**< Constructor */
+    Pic16f8xx(const DeviceSpec *spec, char *name);    /**< Constructor */
     ~Pic16f8xx();             /**< Destructor */
 
 protected:
@@ -586,13 +809,13 @@ public:
         COMMAND_CHIP_ERASE      = 0x1f  /**< Chip Erase                     */
     };
 
-    Pic16f87xA(char *name);   /**< Constructor */
+    Pic16f87xA(const DeviceSpec *spec, char *name);   /**< Constructor */
     ~Pic16f87xA();            /**< Destructor */
 
 protected:
     void disable_codeprotect(void);
     void bulk_erase(void);
-    void write_program_memory(DataBuffer& buf, long base=0);
+    void program_row_cycle(void);
     void write_config_word(uint32_t data);
 };
 
@@ -601,7 +824,7 @@ protected:
 class Pic16f6xx : public Pic16
 {
 public:
-    Pic16f6xx(char *name);    /**< Constructor */
+    Pic16f6xx(const DeviceSpec *spec, char *name);    /**< Constructor */
     ~Pic16f6xx();             /**< Destructor */
 
 protected:
@@ -617,7 +840,7 @@ protected:
 class Pic12f6xx : public Pic16
 {
 public:
-    Pic12f6xx(char *name);    /**< Constructor */
+    Pic12f6xx(const DeviceSpec *spec, char *name);    /**< Constructor */
     ~Pic12f6xx();             /**< Destructor */
 
 protected:
@@ -630,7 +853,7 @@ protected:
 class Pic16f7x : public Pic16
 {
 public:
-    Pic16f7x(char *name); /**< Constructor */
+    Pic16f7x(const DeviceSpec *spec, char *name); /**< Constructor */
     ~Pic16f7x();          /**< Destructor */
 
 protected:
@@ -664,6 +887,8 @@ protected:
 #define ASM_MOVF_EEDATA_W_0  0x50a8                 /* movf EEDATA, W, 0 */
 #define ASM_MOVF_EECON1_W_0  0x50a6                 /* movf EECON1, W, 0 */
 #define ASM_INCF_TBLPTR      0x2af6                 /* incf TBLPTR       */
+#define ASM_INCF_EEADR       0x2aa9                 /* incf EEADR        */
+#define ASM_INCF_EEADRH      0x2aaa                 /* incf EEADRH       */
 #define ASM_MOVWF_EECON2     0x6ea7                 /* movwf EECON2      */
 
 /** A class which implements the programming algorithm PIC18* devices. The
@@ -696,13 +921,23 @@ public:
         COMMAND_TABLE_WRITE_START   = 0x0f  /**< Table Write, start program. */
     };
 
-    Pic18(char *name);    /**< Constructor */
+    Pic18(const DeviceSpec *spec, char *name);    /**< Constructor */
     virtual ~Pic18();     /**< Destructor */
 
     virtual void erase(void);
     virtual void program(DataBuffer& buf);
     virtual void read(DataBuffer& buf, bool verify=false);
 
+    /** Reprogram the device erasing and writing only the 64 byte program
+     * memory blocks which changed. The configuration and data EEPROM bytes
+     * are written only if they changed. If an ID location needs a bit to
+     * be set, the whole device is erased and programmed instead.
+     * \param buf The DataBuffer containing the data to program.
+     * \param current The current contents of the device, or NULL to read
+     *        them from the device.
+     */
+    virtual void reprogram(DataBuffer& buf, DataBuffer *current=NULL);
+
     /** Gets the native clearvalue depending on the memory address
      * \returns The clearvalue.
      */
@@ -715,7 +950,8 @@ protected:
     virtual void block_erase(int len, int address);
 
     /** Writes data to the program memory. The entire code space is written
-     * to take advantage of multi-panel writes.
+     * to take advantage of multi-panel writes. The blank (all 0xffff) panel
+     * rows are neither written nor verified, but still counted.
      * \param buf The DataBuffer from which to retrieve the data to write.
      * \param verify A boolean value indicating if the written data should be
      *        read back and verified.
@@ -729,6 +965,25 @@ protected:
      */
     virtual void write_program_memory(DataBuffer& buf, bool verify);
 
+    /** Writes a range of program memory in single panel mode.
+     * \param buf The DataBuffer from which to retrieve the data to write.
+     * \param addr The byte address of the range, a multiple of 8.
+     * \param len The byte length of the range, a multiple of 8.
+     * \param verify A boolean value indicating if the written data should be
+     *        read back and verified.
+     * \pre The range has been erased.
+     * \post The \c progress_count is incremented as for
+     *       write_program_memory().
+     * \throws runtime_error Contains a description of the error along with
+     *         the address at which the error occurred.
+     */
+    virtual void write_program_rows (
+        DataBuffer& buf,
+        unsigned long addr,
+        unsigned long len,
+        bool verify
+    );
+
     /** Writes the ID memory locations.
      * \param buf The DataBuffer from which data is read.
      * \param addr The byte address of the ID words in the PIC address space.
@@ -754,6 +1009,8 @@ protected:
      *             retrieving data.
      * \param verify A boolean value indicating if the written data should be
      *        read back and verified.
+     * Each byte is read first and written only if it doesn't already hold
+     * the value, in which case it doesn't need to be verified either.
      * \post The \c progress_count is incremented by the number of bytes
      *       written to the data memory. If \c verify is true then
      *       \c progress_count will have been incremented by two times the
@@ -774,6 +1031,8 @@ protected:
      *        address space.
      * \param verify A boolean value indicating if the written data should be
      *        read back and verified.
+     * Only the configuration bytes which differ from the device contents
+     * are written.
      * \post The \c progress_count is incremented by the number of
      *       configuration words written. If \c verify is true then
      *       \c progress_count will have been incremented by two times the
@@ -878,12 +1137,66 @@ protected:
      */
     virtual void program_delay(bool hold_clock_high=true);
 
+    /** Puts the PIC in program mode, forgetting the TBLPTR and EEADR
+     * values since the PIC has been reset. */
+    virtual void set_program_mode(void);
+
+    /** Turns off the PIC, forgetting the TBLPTR and EEADR values. */
+    virtual void pic_off(void);
+
+    /** The PIC18 TBLPTR and EEADR registers can be loaded at any time, so
+     * the PIC stays in program mode between the steps of a job. */
+    virtual bool keep_program_mode(void);
+
     /** Sets the value of the PIC's internal TBLPTR register. This register
-     * contains the address of the current read/write operation.
+     * contains the address of the current read/write operation. Only the
+     * bytes which differ from the value TBLPTR is known to have are loaded.
      * \param addr The byte address within the PIC's address space.
      */
     virtual void set_tblptr(unsigned long addr);
 
+    /** Sets the data EEPROM address registers. As for set_tblptr(), only
+     * the bytes which differ from the known value of EEADR and EEADRH
+     * are loaded. Walking the addresses in sequence costs a single
+     * INCF EEADR, plus an INCF EEADRH at each 256 bytes boundary.
+     * \param addr The data EEPROM byte address.
+     */
+    virtual void set_eeadr(unsigned int addr);
+
+    /** Gets a data EEPROM byte from a DataBuffer, where the bytes are packed
+     * 2 per 16-bit word, little endian.
+     * \param buf The DataBuffer holding the data EEPROM image.
+     * \param addr The byte address of the data EEPROM in the DataBuffer.
+     * \param offset The offset of the byte in the data EEPROM.
+     * \returns The data byte.
+     */
+    static uint8_t get_ee_byte (
+        DataBuffer& buf,
+        unsigned long addr,
+        unsigned int offset
+    );
+
+    /** Reads the data EEPROM byte at the address loaded in EEADR. The
+     * EEPGD and CFGS bits must be already cleared.
+     * \returns The data byte.
+     */
+    virtual unsigned int read_ee_byte(void);
+
+    /** Reads a configuration word and compares it with the value to write,
+     * counting the implemented bytes which need to be written and the ones
+     * which can be skipped.
+     * \param buf The DataBuffer holding the configuration words to write.
+     * \param addr The byte address of the configuration word.
+     * \param mask The implemented bits of the configuration word.
+     * \returns The implemented bits which differ from the device, all of
+     *          them if the writes can't be skipped, see can_skip_writes().
+     */
+    unsigned int read_config_changes (
+        DataBuffer& buf,
+        unsigned long addr,
+        unsigned int mask
+    );
+
     /** Send a 4-bit command to the PIC.
      * \param command The 4-bit command to write.
      */
@@ -914,13 +1227,26 @@ protected:
     unsigned int config_masks[7];
     unsigned int config_deflt[7];
 
+    /** Shadow copy of the PIC's TBLPTR register, kept up to date by the
+     * table read/write commands. Only meaningful if \c tblptr_valid. */
+    unsigned long tblptr;
+    bool tblptr_valid;
+
+    /** Shadow copy of the PIC's EEADRH:EEADR registers. Only meaningful if
+     * \c eeadr_valid. */
+    unsigned int eeadr;
+    bool eeadr_valid;
+
+    /** False if the PIC has no EEADRH register (256 bytes data EEPROM) */
+    bool has_eeadrh;
+
     static const Instruction opcodes[];
 };
 
 class Pic18fxx20 : public Pic18
 {
 public:
-    Pic18fxx20(char *name);
+    Pic18fxx20(const DeviceSpec *spec, char *name);
     virtual ~Pic18fxx20();
 
     virtual void erase(void);
@@ -941,6 +1267,16 @@ protected:
      */
     virtual void write_program_memory(DataBuffer& buf, bool verify);
 
+    /** Writes a range of program memory, write_buffer_size bytes at a time.
+     * The range must be aligned to the write buffer size.
+     */
+    virtual void write_program_rows (
+        DataBuffer& buf,
+        unsigned long addr,
+        unsigned long len,
+        bool verify
+    );
+
     /** Writes the ID memory locations.
      * \param buf The DataBuffer from which data is read.
      * \param addr The byte address of the ID words in the PIC address space.
@@ -966,6 +1302,9 @@ protected:
      *             retrieving data.
      * \param verify A boolean value indicating if the written data should be
      *        read back and verified.
+     * Each byte is read first and written only if it doesn't already hold
+     * the value, in which case it doesn't need to be verified either. On a
+     * gang the bytes can't be read first, the blank (0xff) ones are skipped.
      * \post The \c progress_count is incremented by the number of bytes
      *       written to the data memory. If \c verify is true then
      *       \c progress_count will have been incremented by two times the
@@ -986,6 +1325,8 @@ protected:
      *        address space.
      * \param verify A boolean value indicating if the written data should be
      *        read back and verified.
+     * Only the configuration bytes which differ from the device contents
+     * are written.
      * \post The \c progress_count is incremented by the number of
      *       configuration words written. If \c verify is true then
      *       \c progress_count will have been incremented by two times the
@@ -1035,6 +1376,12 @@ protected:
         unsigned long count
     );
 
+    /** Reads the data EEPROM byte at the address loaded in EEADR, with the
+     * NOP required by these devices after loading TABLAT.
+     * \returns The data byte.
+     */
+    virtual unsigned int read_ee_byte(void);
+
     /** Does a custom NOP/program wait. This will output
      * COMMAND_CORE_INSTRUCTION, hold clk high for the programming time,
      * and then finish up by clocking out a nop instruction (16 0's).
@@ -1051,7 +1398,7 @@ public:
     /**< Table Write, start programming, post-inc by 2 */
     const static int COMMAND_TABLE_WRITE_START_POSTINC=0x0e; 
 
-    Pic18f2xx0(char *name);
+    Pic18f2xx0(const DeviceSpec *spec, char *name);
     virtual ~Pic18f2xx0();
 
     virtual void erase(void);
@@ -1063,6 +1410,9 @@ protected:
      *             retrieving data.
      * \param verify A boolean value indicating if the written data should be
      *        read back and verified.
+     * Each byte is read first and written only if it doesn't already hold
+     * the value, in which case it doesn't need to be verified either. On a
+     * gang the bytes can't be read first, the blank (0xff) ones are skipped.
      * \post The \c progress_count is incremented by the number of bytes
      *       written to the data memory. If \c verify is true then
      *       \c progress_count will have been incremented by two times the
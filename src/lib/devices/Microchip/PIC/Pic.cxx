@@ -17,77 +17,117 @@
  * $Id: Pic.cxx,v 1.20 2002/10/19 19:09:00 marka Exp $
  */
 #include <stdio.h>
+#include <string.h>
 #include <stdexcept>
+#include <vector>
+#include <map>
+#include <string>
 
 using namespace std;
 
 #include "Microchip.h"
 #include "IO.h"
 #include "Util.h"
+#include "RegularExpression.h"
+
+typedef enum {
+    FAMILY_PIC16F87XA,
+    FAMILY_PIC16F88X,
+    FAMILY_PIC16F8XX,
+    FAMILY_PIC16F7X,
+    FAMILY_PIC16F6XX,
+    FAMILY_PIC12F6XX,
+    FAMILY_PIC16,
+    FAMILY_PIC18FXX20,
+    FAMILY_PIC18F2XX0,
+    FAMILY_PIC18,
+    FAMILY_UNKNOWN
+} PicFamily;
+
+/* The families in order of precedence: the first pattern matching the
+ * device name selects the class implementing it */
+static const struct {
+    const char *pattern;
+    PicFamily family;
+} picFamilies[] = {
+    { "^PIC16F87[3467]A",                             FAMILY_PIC16F87XA },
+    { "^PIC16F88[23467]",                             FAMILY_PIC16F88X  },
+    { "^((PIC16F8)|(PIC16C84$))",                     FAMILY_PIC16F8XX  },
+    { "^PIC16F7[3467]$",                              FAMILY_PIC16F7X   },
+    { "^PIC16F6",                                     FAMILY_PIC16F6XX  },
+    { "^PIC12F6",                                     FAMILY_PIC12F6XX  },
+    { "^PIC16",                                       FAMILY_PIC16      },
+    { "^PIC18F([124][23]20)",                         FAMILY_PIC18FXX20 },
+    { "^PIC18F((2..[05])|(2.21)|(4..[05])|(4.21))",   FAMILY_PIC18F2XX0 },
+    { "^PIC18",                                       FAMILY_PIC18      },
+    { NULL,                                           FAMILY_UNKNOWN    }
+};
+
+/* Finds the family of a device. The patterns are compiled the first time
+ * and the family of each name is remembered, so a name is only matched
+ * once. Like DeviceSpec::lookup(), this is called from a single thread. */
+static PicFamily picFamily(const char *name)
+{
+static vector<RegularExpression *> compiled;
+static map<string, PicFamily> families;
+map<string, PicFamily>::iterator n;
+PicFamily family = FAMILY_UNKNOWN;
+
+    n = families.find(name);
+    if (n != families.end()) {
+        return n->second;
+    }
+    if (compiled.empty()) {
+        for (int i=0; picFamilies[i].pattern; i++) {
+            compiled.push_back(new RegularExpression(picFamilies[i].pattern));
+        }
+    }
+    for (unsigned int i=0; i<compiled.size(); i++) {
+        if (compiled[i]->find(name)) {
+            family = picFamilies[i].family;
+            break;
+        }
+    }
+    families[name] = family;
+
+    return family;
+}
 
-Device *Pic::load(char *name)
+Device *Pic::load(const DeviceSpec *spec, char *name)
 {
-    if(
-        Util::regexMatch("^PIC16F87[3467]A", name)
-    ) {
-        return new Pic16f87xA(name);
-    } else if (
-        Util::regexMatch("^PIC16F88[23467]", name)
-    ) {
-    	return new Pic16f88x(name);
-    } else if (
-        Util::regexMatch("^PIC16F8", name) ||
-        (strcmp(name, "PIC16C84") == 0)
-    ) {
-        return new Pic16f8xx(name);
-    } else if (
-        Util::regexMatch("^PIC16F7[3467]$", name)
-    ) {
-        return new Pic16f7x(name);
-    } else if (
-        Util::regexMatch("^PIC16F6.*", name)
-    ) {
-        return new Pic16f6xx(name);
-    } else if (
-        Util::regexMatch("^PIC12F6.*", name)
-    ) {
-        return new Pic12f6xx(name);
-    } else if (
-        Util::regexMatch("^PIC16.*", name)
-    ) {
-        return new Pic16(name);
-    } else if (
-        Util::regexMatch("^PIC18F([124][23]20)", name)
-    ) {
-        return new Pic18fxx20(name);
-    } else if (
-        Util::regexMatch("^PIC18F((2..[05])|(2.21)|(4..[05])|(4.21))", name)
-    ) {
-        return new Pic18f2xx0(name);
-    } else if (
-        Util::regexMatch("^PIC18.*", name)
-    ) {
-        return new Pic18(name);
-    } else {
-        throw runtime_error (
-            (const char *)Preferences::Name (
-                "Unknown PIC device %s",
-                name
-            )
-        );
+    switch (picFamily(name)) {
+        case FAMILY_PIC16F87XA: return new Pic16f87xA(spec, name);
+        case FAMILY_PIC16F88X:  return new Pic16f88x(spec, name);
+        case FAMILY_PIC16F8XX:  return new Pic16f8xx(spec, name);
+        case FAMILY_PIC16F7X:   return new Pic16f7x(spec, name);
+        case FAMILY_PIC16F6XX:  return new Pic16f6xx(spec, name);
+        case FAMILY_PIC12F6XX:  return new Pic12f6xx(spec, name);
+        case FAMILY_PIC16:      return new Pic16(spec, name);
+        case FAMILY_PIC18FXX20: return new Pic18fxx20(spec, name);
+        case FAMILY_PIC18F2XX0: return new Pic18f2xx0(spec, name);
+        case FAMILY_PIC18:      return new Pic18(spec, name);
+        default:
+            throw runtime_error (
+                (const char *)Preferences::Name (
+                    "Unknown PIC device %s",
+                    name
+                )
+            );
+        break;
     }
     return NULL;
 }
 
-Pic::Pic(char *name) : Microchip(name)
+Pic::Pic(const DeviceSpec *spec, char *name) : Microchip(spec, name)
 {
 char memtypebuf[10];
 
     this->popcodes = NULL;
+    this->pdecode  = NULL;
 
     this->flags = 0;
     /* Fill in this PIC's common attributes */
-    if (!config->get("memType",memtypebuf,"rom",10)) {
+    if (!spec->get("memType",memtypebuf,"rom",10)) {
         throw runtime_error (
             "PIC device is missing memtype configuration entry"
         );
@@ -103,20 +143,20 @@ char memtypebuf[10];
     } else {
         throw runtime_error("PIC device has an unknown memory type");
     }
-    if (!config->get("wordSize",(int &)this->wordsize,0)) {
+    if (!spec->get("wordSize",(int &)this->wordsize,0)) {
         throw runtime_error(
         	"PIC device is missing wordSize configuration entry");
     }
-    if (!config->get("codeSize",(int &)this->codesize,0)) {
+    if (!spec->get("codeSize",(int &)this->codesize,0)) {
         throw runtime_error(
         	"PIC device is missing codeSize configuration entry");
     }
-    if (!config->get("configWords",(int &)this->config_words,1)) {
+    if (!spec->get("configWords",(int &)this->config_words,1)) {
         throw runtime_error(
         	"PIC device is missing configWords configuration entry"
         );
     }
-    if (config->get("eepromSize",(int &)this->eesize,0) && (this->eesize>0)) {
+    if (spec->get("eepromSize",(int &)this->eesize,0) && (this->eesize>0)) {
         this->flags |= PIC_FEATURE_EEPROM;
     } else {
         this->eesize=0;
@@ -129,7 +169,7 @@ char memtypebuf[10];
     }
     /* Get the device ID value if this device supports it. */
     if (
-        config->getHex (
+        spec->getHex (
             Preferences::Name("deviceID"), 
             (int &)this->deviceid, 
             0xffff
@@ -137,7 +177,7 @@ char memtypebuf[10];
         (this->deviceid>0)
     ) {
         if (
-            config->getHex (
+            spec->getHex (
                 Preferences::Name("deviceIDMask"), 
                 (int &)this->deviceidmask, 
                 0xffff
@@ -148,14 +188,25 @@ char memtypebuf[10];
         }
     }
     /* Read programming parameters with defaults for an EPROM device */
-    config->get("progCount"      ,(int &)program_count     , 25);
-    config->get("progMult"       ,(int &)program_multiplier,  3);
-    config->get("progTime"       ,(int &)program_time      ,100);
-    config->get("eraseTime"      ,(int &)erase_time        ,  0);
+    spec->get("progCount"      ,(int &)program_count     , 25);
+    spec->get("progMult"       ,(int &)program_multiplier,  3);
+    spec->get("progTime"       ,(int &)program_time      ,100);
+    spec->get("eraseTime"      ,(int &)erase_time        ,  0);
 
     /* read the write/erase buffer sizes with default for P18F4550 */
-    config->get("writeBufferSize",(int &)write_buffer_size , 32);
-    config->get("eraseBufferSize",(int &)erase_buffer_size , 64);
+    spec->get("writeBufferSize",(int &)write_buffer_size , 32);
+    spec->get("eraseBufferSize",(int &)erase_buffer_size , 64);
+
+    /* Read the ICSP timings, the defaults are the historical delays */
+    spec->get("tPPDP"          ,(int &)timing.tppdp      ,1000);
+    spec->get("tHLD0"          ,(int &)timing.thld0      ,1000);
+    spec->get("tDLY1"          ,(int &)timing.tdly1      ,   1);
+    spec->get("tDLY2"          ,(int &)timing.tdly2      ,   1);
+    spec->get("tDIS"           ,(int &)timing.tdis       , 100);
+    spec->get("tOFF"           ,(int &)timing.toff       ,10000);
+    spec->get("tEXIT"          ,(int &)timing.texit      ,1000);
+
+    this->program_mode = false;
 }
 
 Pic::~Pic()
@@ -178,28 +229,48 @@ bool Pic::program_cycle(uint32_t data, uint32_t mask)
 
 void Pic::set_program_mode(void)
 {
+    if (this->program_mode) {
+        /* Kept in program mode by the previous step of a job */
+        return;
+    }
     /* Power up the PIC and put it in program/verify mode */
     this->io->clock(false);        /* Set RB6 low */
     this->io->data(false);         /* Set RB7 low */
     this->io->vdd(IO::VDD_TO_ON);  /* Raise Vdd while RB6 & RB7 are low */
-    this->io->usleep(1000);        /* Wait a bit */
+    this->io->usleep(this->timing.tppdp);
     this->io->vpp(IO::VPP_TO_VIH); /* Raise Vpp while RB6 & RB7 are low */
-    this->io->usleep(1000);        /* Wait a bit */
+    this->io->usleep(this->timing.thld0);
+    this->program_mode = true;
 }
 
 void Pic::pic_off(void)
 {
+    if (this->in_session && this->program_mode && this->keep_program_mode()) {
+        /* The job turns the PIC off at its end */
+        return;
+    }
     /* Shut everything down */
     this->io->clock(false);
     this->io->data(false);
     this->io->vpp(IO::VPP_TO_GND);
     this->io->vdd(IO::VDD_TO_OFF);
+    this->program_mode = false;
+}
+
+bool Pic::keep_program_mode(void)
+{
+    return false;
+}
+
+void Pic::end_session(void)
+{
+    this->pic_off();
 }
 
 void Pic::write_command(uint32_t command)
 {
     this->io->shift_bits_out(command, 6, 1, 1);
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly1);
 }
 
 void Pic::write_prog_data(uint32_t data)
@@ -207,7 +278,7 @@ void Pic::write_prog_data(uint32_t data)
     data = (data & this->wordmask) << 1;
     this->write_command(COMMAND_LOAD_PROG_DATA);
     this->io->shift_bits_out(data, 16, 1);
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly2);
 }
 
 uint32_t Pic::read_prog_data(void)
@@ -216,181 +287,247 @@ uint32_t data;
 
     this->write_command(COMMAND_READ_PROG_DATA);
     data = this->io->shift_bits_in(16, 1);
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly2);
     return (data >> 1) & this->wordmask;
 }
 
-void Pic::dump(DataBuffer& buf)
+void Pic::dump_rows(DataBuffer& buf, DumpRowVector& rows)
 {
-    if (!this->dump_cb) {
-        return;
-    }
-
-int start, len, addr, bytes, buffer, data, i, j, area, num_words;
-bool writable, put_separator;
+unsigned long start, end, addr;
 int bufwordsize = ((buf.get_wordsize() + 7) & ~7) / 8;
-static char line[256], disasm[256], ascii[9], title[256];
-int byte_address = 0;
+int words = (8 + bufwordsize - 1) / bufwordsize;
+int area, num_words;
 
 IntPairVector::iterator n = memmap.begin();
 
-    if ( this->wordsize == 16 ) {
-        byte_address = 1;
-    }
-    this->dump_cb(this->dump_cb_data,(const char *)0,-1);
+    rows.clear();
     for (area=0; n != memmap.end(); n++, area++) {
         start = n->first;
-        len   = n->second;
-        addr  = start;
-        put_separator = true;
+        end   = n->first + n->second;
+        if (start >= end) {
+            continue;
+        }
+        if (area > 0) {
+            add_row(rows, start, area, DUMP_BLANK);
+        }
+        add_row(rows, start, area, DUMP_TITLE);
+        add_row(rows, start, area, DUMP_RULE);
+        add_row(rows, start, area, DUMP_SPACE);
+        if (area > 0) {
+            /* data area, 8 bytes per row */
+            for (addr=start; addr<end; addr+=words) {
+                add_row(rows, addr, area, DUMP_DATA);
+            }
+            continue;
+        }
+        /* code area, a row per non blank word. The further words of an
+         * instruction follow it, skipping the blank ones. */
         num_words = 0;
-        while (addr < (unsigned long)start+len) {
-            writable = false;
-            if (area==0) {
-                /* code area, need to disassemble */
-                if (!buf.isblank(addr,this->get_clearvalue(addr))) {
-                    disasm[0]='\0';
-                    if (num_words == 0) {
-                        num_words = this->mem2asm(addr,buf,disasm,sizeof(disasm));
-                    }
-                    if (num_words) {
-                        writable = true;
-                        sprintf (
-                            line,
-                            "%07x):  %04x  %s",
-                            addr << byte_address,
-                            buf[addr] & 0xffff,
-                            disasm
-                        );
-                        num_words--;
-                    }
+        for (addr=start; addr<end; addr++) {
+            if (buf.isblank(addr,this->get_clearvalue(addr))) {
+                continue;
+            }
+            if (num_words == 0) {
+                num_words = this->insn_words(addr,buf);
+                if (num_words) {
+                    add_row(rows, addr, area, DUMP_CODE);
+                    num_words--;
                 }
-                addr++;
             } else {
-                /* data area, do not disassemble */
-                sprintf(line,"%07x)", addr << byte_address);
-                for (i=0, bytes=0; bytes<8; bytes+=bufwordsize) {
-                    if (area>0 || !buf.isblank(addr,this->get_clearvalue(addr))) {
-                        writable = true;
-                    }
-                    if (addr < (unsigned long)start+len) {
-                        buffer = buf[addr];
-                        for (j=0; j<bufwordsize; j++) {
-                            data = buffer & 0xff;
-                            sprintf(line,"%s %02x", line, data);
-                            ascii[i++] = (isprint(data)) ? data : '.';
-                            buffer >>= 8;
-                        }
-                        addr++;
-                    } else {
-                        for (j=0; j<bufwordsize; j++) {
-                            sprintf(line,"%s   ", line);
-                            ascii[i++] = ' ';
-                        }
-                    }
-                }
-                ascii[i] = '\0';
-                sprintf(line,"%s |%s|", line, ascii);
+                add_row(rows, addr, area, DUMP_OPERAND);
+                num_words--;
             }
-            if (put_separator) {
-                if (area>0) {
-                    this->dump_cb(this->dump_cb_data,"",-1);
-                }
-                title[0] = '\0';
-                switch (area) {
-                    case 0:
-                        snprintf (
-                            title, sizeof(title),
-                            "@C255@_@b@C0Program memory (%s address)",
-                            (byte_address) ? "byte" : "word"
-                        );
-                        break;                            
-                    case 1:                               
-                        snprintf (
-                            title, sizeof(title),
-                            "@C255@_@b@C0ID locations (%s address)",
-                            (byte_address) ? "byte" : "word"
-                        );
-                        break;                            
-                    case 2:                               
-                        snprintf (
-                            title, sizeof(title),
-                            "@C255@_@b@C0Config words (%s address)",
-                            (byte_address) ? "byte" : "word"
-                        );
-                        break;                            
-                    default:                              
-                        snprintf (
-                            title, sizeof(title),
-                            "@C255@_@b@C0EEPROM (%s address)",
-                            (byte_address) ? "byte" : "word"
-                        );
-                        break;
-                }
-                if (title[0]) {
-                    this->dump_cb(this->dump_cb_data,title,-1);
-                }
-                this->dump_cb(this->dump_cb_data,"@-",-1);
-                this->dump_cb(this->dump_cb_data,"@s",-1);
-                put_separator = false;
+        }
+    }
+}
+
+void Pic::dump_row (
+    DataBuffer& buf,
+    const DumpRow& row,
+    char *line,
+    size_t size
+) {
+static const char *titles[] = {
+    "Program memory", "ID locations", "Config words", "EEPROM"
+};
+int byte_address = (this->wordsize == 16) ? 1 : 0;
+char disasm[256];
+
+    switch (row.kind) {
+        case DUMP_TITLE:
+            snprintf (
+                line, size,
+                "%s (%s address)",
+                titles[(row.area < 3) ? row.area : 3],
+                (byte_address) ? "byte" : "word"
+            );
+        break;
+        case DUMP_CODE:
+        case DUMP_OPERAND:
+            disasm[0] = '\0';
+            if (row.kind == DUMP_CODE) {
+                this->mem2asm(row.addr,buf,disasm,sizeof(disasm));
             }
-            if (writable) {
-                this->dump_cb (
-                    this->dump_cb_data,
-                    (const char *)line,
-                    -1
-                );
+            snprintf (
+                line, size,
+                "%07lx):  %04x  %s",
+                row.addr << byte_address,
+                buf[row.addr] & 0xffff,
+                disasm
+            );
+        break;
+        case DUMP_DATA:
+            this->dump_data_row(buf, row, row.addr << byte_address, line, size);
+        break;
+        default:
+            if (size > 0) {
+                line[0] = '\0';
             }
-        }
+        break;
     }
 }
 
 #define UNKNOWN_OPCODE -1
+#define UNKNOWN_INSTRUCTION 0xff
+
+#define DECODE_INSN(SUFFIX, ARGS, ARG1, ARG2, ARG3) \
+    formatInstruction(buffer, sizeof_buffer, this->popcodes[instruction].name,\
+                      SUFFIX, ARGS, ARG1, ARG2, ARG3)
+
+#define DECODE_ARG0                   DECODE_INSN(NULL, 0, 0, 0, 0)
+
+#define DECODE_ARG1(ARG1)             DECODE_INSN(NULL, 1, ARG1, 0, 0)
+
+#define DECODE_ARG1WF(ARG1, ARG2)     DECODE_INSN((ARG2 ? ", f" : ", w"), \
+                                                  1, ARG1, 0, 0)
+
+#define DECODE_ARG2(ARG1, ARG2)       DECODE_INSN(NULL, 2, ARG1, ARG2, 0)
+
+#define DECODE_ARG3(ARG1, ARG2, ARG3) DECODE_INSN(NULL, 3, ARG1, ARG2, ARG3)
+
+/* Writes "name\targ1, arg2, arg3suffix" with the arguments as "%#lx" would.
+ * This runs for every word of a listing, where snprintf() would take most
+ * of the time. */
+static void formatInstruction (
+    char *buffer,
+    size_t sizeof_buffer,
+    const char *name,
+    const char *suffix,
+    int args,
+    unsigned long arg1,
+    unsigned long arg2,
+    unsigned long arg3
+) {
+static const char hex[] = "0123456789abcdef";
+unsigned long arg[3];
+char line[128], digits[16], *p = line;
+size_t len;
+int i, n;
+
+    arg[0] = arg1;
+    arg[1] = arg2;
+    arg[2] = arg3;
+    while (*name && p < line + 16) {
+        *p++ = *name++;
+    }
+    for (i=0; i<args; i++) {
+        *p++ = (i == 0) ? '\t' : ',';
+        if (i > 0) {
+            *p++ = ' ';
+        }
+        if (arg[i] == 0) {
+            *p++ = '0';
+            continue;
+        }
+        for (n=0; arg[i]; arg[i] >>= 4) {
+            digits[n++] = hex[arg[i] & 0xf];
+        }
+        *p++ = '0';
+        *p++ = 'x';
+        while (n > 0) {
+            *p++ = digits[--n];
+        }
+    }
+    while (suffix && *suffix) {
+        *p++ = *suffix++;
+    }
+    len = p - line;
+    if (sizeof_buffer == 0) {
+        return;
+    }
+    if (len >= sizeof_buffer) {
+        len = sizeof_buffer - 1;
+    }
+    memcpy(buffer, line, len);
+    buffer[len] = '\0';
+}
 
-#define DECODE_ARG0                   snprintf(buffer, sizeof_buffer, \
-                                               "%s", \
-                                               this->popcodes[instruction].name)
-                                     
-#define DECODE_ARG1(ARG1)             snprintf(buffer, sizeof_buffer, \
-                                               "%s\t%#lx", \
-                                               this->popcodes[instruction].name,\
-                                               ARG1)
-                                     
-#define DECODE_ARG1WF(ARG1, ARG2)     snprintf(buffer, sizeof_buffer, \
-                                               "%s\t%#lx, %s", \
-                                               this->popcodes[instruction].name,\
-                                               ARG1, \
-                                               (ARG2 ? "f" : "w"))
-                                     
-#define DECODE_ARG2(ARG1, ARG2)       snprintf(buffer, sizeof_buffer, \
-                                               "%s\t%#lx, %#lx", \
-                                               this->popcodes[instruction].name,\
-                                               ARG1, \
-                                               ARG2)
-
-#define DECODE_ARG3(ARG1, ARG2, ARG3) snprintf(buffer, sizeof_buffer, \
-                                               "%s\t%#lx, %#lx, %#lx", \
-                                               this->popcodes[instruction].name, \
-                                               ARG1, \
-                                               ARG2, \
-                                               ARG3)
+const unsigned char *Pic::decoder(const Instruction *opcodes)
+{
+static map<const Instruction *, unsigned char *> decoders;
+unsigned char *table;
+unsigned int i, n, free;
+
+    if (decoders.count(opcodes)) {
+        return decoders[opcodes];
+    }
+    table = new unsigned char[0x10000];
+    memset(table, UNKNOWN_INSTRUCTION, 0x10000);
+    for (n=0; opcodes[n].name; n++)
+        ;
+    /* Store the instructions from the last one, so the first one which
+     * matches a word overwrites the others. Each instruction matches its
+     * opcode with any combination of the bits outside its mask. */
+    while (n-- > 0) {
+        if (opcodes[n].opcode & ~opcodes[n].mask) {
+            continue;
+        }
+        free = ~opcodes[n].mask & 0xffff;
+        for (i=free; ; i=(i-1) & free) {
+            table[opcodes[n].opcode | i] = n;
+            if (i == 0) {
+                break;
+            }
+        }
+    }
+    decoders[opcodes] = table;
+
+    return table;
+}
+
+int Pic::insn_words(int addr, DataBuffer& buf)
+{
+long opcode = buf[addr] & 0xffff;
+
+    if (!this->pdecode || this->pdecode[opcode] == UNKNOWN_INSTRUCTION) {
+        return 1;
+    }
+    switch (this->popcodes[this->pdecode[opcode]].type) {
+        case INSN_CLASS_NULL:
+        case INSN_CLASS_FUNC:
+            return 0;
+        case INSN_CLASS_LIT20:
+        case INSN_CLASS_CALL20:
+        case INSN_CLASS_FLIT12:
+        case INSN_CLASS_FF:
+        case INSN_CLASS_SF:
+        case INSN_CLASS_SS:
+            return 2;
+        default:
+            return 1;
+    }
+}
 
 int Pic::mem2asm(int addr, DataBuffer& buf, char *buffer, size_t sizeof_buffer)
 {
 int instruction = UNKNOWN_OPCODE;
 int num_words = 1;
-int i;
 int value;
 long opcode;
 
-    if (this->popcodes) {
-        opcode = buf[addr] & 0xffff;
-        for (i=0; this->popcodes[i].name; i++) {
-            if ((opcode & this->popcodes[i].mask) == this->popcodes[i].opcode) {
-                instruction = i;
-                break;
-            }
-        }
+    opcode = buf[addr] & 0xffff;
+    if (this->pdecode && this->pdecode[opcode] != UNKNOWN_INSTRUCTION) {
+        instruction = this->pdecode[opcode];
     }
     if (instruction == UNKNOWN_OPCODE)  {
         snprintf(buffer, sizeof_buffer, "dw\t%#lx  ; '%c'", opcode, isprint(opcode)?opcode:'.');
@@ -465,10 +602,7 @@ long opcode;
                 num_words = 2;
                 dest = (buf[addr+1] & 0xfff) << 8;
                 dest |= opcode & 0xff;      
-                snprintf(buffer, sizeof_buffer, "%s\t%#lx, %#lx",
-                         this->popcodes[instruction].name,
-                         dest * 2,
-                         (opcode >> 8) & 1);
+                DECODE_ARG2(dest * 2, (opcode >> 8) & 1);
             }
             break;
         case INSN_CLASS_FLIT12:
@@ -621,7 +755,9 @@ uint32_t devid;
 
         /* Wait a bit to make sure program mode is off before continuing
          * with other operations on the device. */
-        this->io->usleep(1000);
+        if (!this->program_mode) {
+            this->io->usleep(this->timing.texit);
+        }
     } catch (std::exception& e) {
         this->pic_off();
         throw;
@@ -25,7 +25,7 @@ using namespace std;
 #include "Util.h"
 
 
-Pic12f6xx::Pic12f6xx(char *name) : Pic16(name)
+Pic12f6xx::Pic12f6xx(const DeviceSpec *spec, char *name) : Pic16(spec, name)
 {
     this->flags |= PIC_HAS_OSCAL;
 }
@@ -25,6 +25,10 @@ using namespace std;
 #include "IO.h"
 #include "Util.h"
 
+/* A Load PC Address (6 bit command, 24 bit payload) costs as much as
+ * 5 INC_ADDRESS commands */
+#define PIC16_LOAD_PC_COST 5
+
 const Instruction Pic16::opcodes[] = {
   { "addlw" , 0x3e00, 0x3e00, INSN_CLASS_LIT8     },
   { "addwf" , 0x3f00, 0x0700, INSN_CLASS_OPWF7    },
@@ -66,36 +70,37 @@ const Instruction Pic16::opcodes[] = {
   { 0       , 0x0000, 0x0000, INSN_CLASS_NULL     }
 };
 
-Pic16::Pic16(char *name) : Pic(name)
+Pic16::Pic16(const DeviceSpec *spec, char *name) : Pic(spec, name)
 {
 	int tmp;
 	int	i;
 
     this->popcodes = this->opcodes;
+    this->pdecode  = Pic::decoder(this->opcodes);
 
     /* Read configuration word bits */
-//    config->getHex("cw_mask_00",(int &)config_mask[0],this->wordmask);
-//    config->getHex("cw_save_00",(int &)persistent_config_mask[0],0);
-//    config->getHex("cw_defs_00",(int &)default_config_word[0],0xffff);
+//    spec->getHex("cw_mask_00",(int &)config_mask[0],this->wordmask);
+//    spec->getHex("cw_save_00",(int &)persistent_config_mask[0],0);
+//    spec->getHex("cw_defs_00",(int &)default_config_word[0],0xffff);
 //    default_config_word[0] &= config_mask[0];
 //    if (this->config_words > 1) {
-//    	config->getHex("cw_mask_00",(int &)config_mask[1],this->wordmask);
-//    	config->getHex("cw_save_00",(int &)persistent_config_mask[1],0);
-//    	config->getHex("cw_defs_00",(int &)default_config_word[1],0xffff);
+//    	spec->getHex("cw_mask_00",(int &)config_mask[1],this->wordmask);
+//    	spec->getHex("cw_save_00",(int &)persistent_config_mask[1],0);
+//    	spec->getHex("cw_defs_00",(int &)default_config_word[1],0xffff);
 //    	default_config_word[1] &= config_mask[1];
 //    }
 	for (i=0; i<this->config_words; i++) {
-		config->getHex (
+		spec->getHex (
 			Preferences::Name("cw_mask_%02d", i),
 			(int &)config_mask[i],
 			this->wordmask
 		);
-		config->getHex (
+		spec->getHex (
 			Preferences::Name("cw_save_%02d", i),
 			(int &)persistent_config_mask[i],
 			0
 		);
-		config->getHex (
+		spec->getHex (
 			Preferences::Name("cw_defs_%02d", i),
 			(int &)default_config_word[i],
 			0xffff
@@ -103,15 +108,30 @@ Pic16::Pic16(char *name) : Pic(name)
 		default_config_word[i] &= config_mask[i];
 	}
 
-    config->getHex("cp_mask_00",(int &)cp_mask, 0);
-    config->getHex("cp_all__00",(int &)cp_all,  0);
-    config->getHex("cp_none_00",(int &)cp_none, 0);
-    config->getHex("dp_mask_00",(int &)cpd_mask,0);
-    config->getHex("dp_on___00",(int &)cpd_on,  0);
-    config->getHex("dp_off__00",(int &)cpd_off, 0);
-    if (config->getHex("bd_mask_00", tmp, 0)) {
+    spec->getHex("cp_mask_00",(int &)cp_mask, 0);
+    spec->getHex("cp_all__00",(int &)cp_all,  0);
+    spec->getHex("cp_none_00",(int &)cp_none, 0);
+    spec->getHex("dp_mask_00",(int &)cpd_mask,0);
+    spec->getHex("dp_on___00",(int &)cpd_on,  0);
+    spec->getHex("dp_off__00",(int &)cpd_off, 0);
+    /* Number of program words written at once through the write latches */
+    spec->get("progRowSize",(int &)this->prog_row_size,1);
+    if (this->prog_row_size < 1) {
+        this->prog_row_size = 1;
+    }
+    if (spec->getHex("bd_mask_00", tmp, 0)) {
         this->flags |= PIC_FEATURE_BKBUG;
     }
+    /* Enhanced mid-range devices can load the program counter */
+    if (spec->get("loadPCAddress", tmp, 0) && (tmp != 0)) {
+        this->flags |= PIC_FEATURE_LOAD_PC;
+    }
+    /* getHex() gives 0, not the default, for a missing entry */
+    if (!spec->getHex("configBase",(int &)this->config_base,0x2000)) {
+        this->config_base = 0x2000;
+    }
+    this->pc        = 0;
+    this->pc_config = false;
     /* Create the memory map for this device */
     this->memmap.push_back(IntPair (0, this->codesize));
     this->memmap.push_back (
@@ -140,21 +160,12 @@ void Pic16::erase(void)
         /* If we need to save the oscillator calibration value, increment
          * to the OSCAL address and read it. */
         if (this->flags & PIC_HAS_OSCAL) {
-            for (unsigned int i=0; i<this->codesize-1; i++) {
-                this->write_command(COMMAND_INC_ADDRESS);
-            }
+            this->set_pc(this->codesize-1);
             oscal = this->read_prog_data();
         }
         /* Read the current configuration word to determine if code
          * protection needs to be disabled. */
-        this->write_command(COMMAND_LOAD_CONFIG);
-        this->io->shift_bits_out(0x7ffe, 16, 1);   /* Dummy write of all 1's */
-        this->io->usleep(1);
-
-        /* Skip to the configuration word */
-        for (int i=0; i < 7; i++) {
-            this->write_command(COMMAND_INC_ADDRESS);
-        }
+        this->set_pc(0x2007);
         cword = read_config_word();
         this->pic_off();
     } catch (std::exception& e) {
@@ -162,7 +173,7 @@ void Pic16::erase(void)
         throw;
     }
     /* Wait a bit after exiting program mode */
-    this->io->usleep(10000);
+    this->io->usleep(this->timing.toff);
 
     /* If code protection or "data code protection" is enabled, we need to do
      * a disable_codeprotect() */
@@ -178,17 +189,15 @@ void Pic16::erase(void)
     /* Check if we need to restore some state. */
     if ((this->persistent_config_mask != 0) || (this->flags & PIC_HAS_OSCAL)) {
         /* Wait a bit after exiting program mode */
-        this->io->usleep(10000);
+        this->io->usleep(this->timing.toff);
 
         try {
             this->set_program_mode();
 
             /* Restore the OSCAL value */
             if (this->flags & PIC_HAS_OSCAL) {
-                /* Increment to the OSCAL address */
-                for (unsigned int i=0; i<this->codesize-1; i++) {
-                    this->write_command(COMMAND_INC_ADDRESS);
-                }
+                /* Move to the OSCAL address */
+                this->set_pc(this->codesize-1);
                 if (!this->program_one_location(oscal)) {
                     throw runtime_error (
                         (const char *)Preferences::Name (
@@ -201,16 +210,7 @@ void Pic16::erase(void)
             if (this->persistent_config_mask != 0) {
                 try {
                     /* Restore the persistent configuration word bits */
-                    this->write_command(COMMAND_LOAD_CONFIG);
-
-                    /* Dummy write of all 1's */
-                    this->io->shift_bits_out(0x7ffe, 16, 1);
-                    this->io->usleep(1);
-
-                    /* Skip to the configuration word */
-                    for (int i=0; i < 7; i++) {
-                        this->write_command(COMMAND_INC_ADDRESS);
-                    }
+                    this->set_pc(0x2007);
                     write_config_word (
                         (cword & this->persistent_config_mask[0]) |
                         (this->wordmask & ~this->persistent_config_mask[0])
@@ -231,11 +231,13 @@ void Pic16::erase(void)
             throw;
         }
     }
+    this->erased = true;
 }
 
 void Pic16::program(DataBuffer& buf)
 {
-uint32_t data;
+uint32_t data, old;
+IO::GangRead mode;
 
     switch(this->memtype) {
         case MEMTYPE_EPROM:
@@ -246,7 +248,12 @@ uint32_t data;
     }
     this->progress_total = this->codesize + this->eesize + 
     						this->config_words + 4;
+    if (this->trusted_erase() && this->trust_erase_check) {
+        this->progress_total += this->codesize;
+    }
     this->progress_count = 0;
+    this->cells_written  = 0;
+    this->cells_skipped  = 0;
 
     try {
         this->set_program_mode();
@@ -259,9 +266,7 @@ uint32_t data;
             this->write_data_memory(buf, 0x2100);
         }
         /* Write the ID locations */
-        this->write_command(COMMAND_LOAD_CONFIG);
-        this->io->shift_bits_out(0x7ffe, 16, 1);
-        this->io->usleep(1);
+        this->set_pc(0x2000);
         this->write_id_memory(buf, 0x2000);
 
         /* Write the debugger interrupt location if this PIC has one */
@@ -273,22 +278,41 @@ uint32_t data;
                 );
             }
         }
-        /* Skip past the next 3 addresses */
-        for (int i=4; i < 7; i++) {
-            this->write_command(COMMAND_INC_ADDRESS);
-        }
+        /* Skip to the configuration words */
+        this->set_pc(0x2007);
+
         /* Program the config word, keeping the persistent bits. */
         for (int i=0; i < this->config_words; i++) {
+            mode = this->gang_read(IO::GANG_READ_FIRST);
+        	old = read_config_word();
+            this->gang_read(mode);
         	data = buf[0x2007 + i] & ~this->persistent_config_mask[i];
-        	data |= (read_config_word() & this->persistent_config_mask[i]);
-        	this->write_config_word(data);
+        	data |= (old & this->persistent_config_mask[i]);
+        	if (
+        	    !this->can_skip_writes() ||
+        	    diff(data, old, this->config_mask[i])
+        	) {
+        	    this->write_config_word(data);
+        	    this->cells_written++;
+        	} else {
+        	    this->cells_skipped++;
+        	}
             this->write_command(COMMAND_INC_ADDRESS);
         	this->progress_count++;
 	        progress(0x2007 + i);
         }
 
+        /* Check the locations skipped thanks to the erase */
+        if (this->trusted_erase() && this->trust_erase_check) {
+            this->pic_off();
+            this->set_program_mode();
+            this->blank_check_program_memory(buf, 0);
+        }
+        this->erased = false;
+
         this->pic_off();
     } catch (std::exception& e) {
+        this->erased = false;
         this->pic_off();
         throw;
     }
@@ -296,6 +320,8 @@ uint32_t data;
 
 void Pic16::read(DataBuffer& buf, bool verify)
 {
+uint32_t data, mask;
+
     this->progress_total = this->codesize + this->eesize + 4;
     this->progress_count = 0;
 
@@ -310,15 +336,17 @@ void Pic16::read(DataBuffer& buf, bool verify)
             this->read_data_memory(buf, 0x2100, verify);
         }
         /* Read the ID locations */
-        this->write_command(COMMAND_LOAD_CONFIG);
-        this->io->shift_bits_out(0x7ffe, 16, 1); /* Dummy write of all 1's */
-        this->io->usleep(1);
+        this->set_pc(0x2000);
         this->read_id_memory(buf, 0x2000, verify);
 
         /* Read the debugger interrupt location if this PIC has one */
         if (this->flags & PIC_FEATURE_BKBUG) {
             if (verify) {
-                if (diff(buf[0x2004],this->read_prog_data(),this->wordmask)) {
+                data = this->read_prog_data();
+                if (
+                    diff(buf[0x2004],data,this->wordmask) &&
+                    !this->mismatch(0x2004,this->wordmask,buf[0x2004],data)
+                ) {
                     throw runtime_error (
                         "Verification failed at address 0x2004"
                     );
@@ -328,15 +356,21 @@ void Pic16::read(DataBuffer& buf, bool verify)
             }
         }
 
-        /* Skip past 3 addresses */
-       	this->write_command(COMMAND_INC_ADDRESS);
-        this->write_command(COMMAND_INC_ADDRESS);
-        this->write_command(COMMAND_INC_ADDRESS);
-        
+        /* Skip to the configuration words */
+        this->set_pc(0x2007);
+
         progress(0x2007);
         for (int i = 0; i < this->config_words; i++) {
         	if (verify) {
-        	    this->read_config_word(true, buf[0x2007 + i]);
+        	    /* We don't include persistent config bits in a verify */
+        	    mask = this->config_mask[i] & ~this->persistent_config_mask[i];
+        	    data = this->read_config_word();
+        	    if (
+        	        diff(buf[0x2007 + i],data,mask) &&
+        	        !this->mismatch(0x2007 + i,mask,buf[0x2007 + i],data)
+        	    ) {
+        	        throw runtime_error("Couldn't verify config word.");
+        	    }
         	} else {
         	    buf[0x2007 + i] = this->read_config_word();
         	}
@@ -351,6 +385,67 @@ void Pic16::read(DataBuffer& buf, bool verify)
     }
 }
 
+bool Pic16::repair(DataBuffer& buf, MismatchVector& result)
+{
+MismatchVector failed;
+MismatchVector::iterator n;
+bool eeprom;
+
+    if (result.empty()) {
+        return true;
+    }
+    eeprom = false;
+    this->progress_total = result.size();
+    for (n = result.begin(); n != result.end(); n++) {
+        if ((n->addr >= 0x2100) && (this->flags & PIC_FEATURE_EEPROM)) {
+            eeprom = true;
+        }
+    }
+    if (eeprom) {
+        this->progress_total += this->eesize;
+    }
+    this->progress_count = 0;
+    this->cells_written  = 0;
+    this->cells_skipped  = 0;
+
+    try {
+        this->set_program_mode();
+
+        /* The mismatches come in address order: move the program counter
+         * to each failed program memory location and program it again */
+        for (n = result.begin(); n != result.end(); n++) {
+            if (n->addr >= this->codesize) {
+                if (!((n->addr >= 0x2100) && eeprom)) {
+                    failed.push_back(*n);
+                }
+                continue;
+            }
+            progress(n->addr);
+            this->set_pc(n->addr);
+
+            /* program_one_location() verifies what it writes */
+            if (!this->program_one_location((uint32_t)buf[n->addr])) {
+                n->actual = this->read_prog_data() & n->mask;
+                failed.push_back(*n);
+            }
+            this->progress_count++;
+        }
+
+        /* Only the data EEPROM bytes which differ are written again */
+        if (eeprom) {
+            this->set_pc_end();
+            this->write_data_memory(buf, 0x2100);
+        }
+        this->pic_off();
+    } catch (std::exception& e) {
+        this->pic_off();
+        throw;
+    }
+    result = failed;
+
+    return result.empty();
+}
+
 void Pic16::bulk_erase(void)
 {
     try {
@@ -363,7 +458,7 @@ void Pic16::bulk_erase(void)
         this->set_program_mode();
         this->write_command(COMMAND_LOAD_CONFIG);
         this->io->shift_bits_out(0x7ffe, 16, 1);
-        this->io->usleep(1);
+        this->io->usleep(this->timing.tdly2);
         this->write_command(COMMAND_ERASE_PROG_MEM);
         this->write_command(COMMAND_BEGIN_PROG);
         this->io->usleep(this->erase_time);
@@ -397,17 +492,25 @@ void Pic16::write_program_memory(DataBuffer& buf, long base)
 {
 unsigned int offset;
 
+    /* Use the write latches if the device has them */
+    if ((this->memtype == MEMTYPE_FLASH) && (this->prog_row_size > 1)) {
+        this->write_program_rows(buf, base);
+        return;
+    }
     try {
         for (offset=0; offset < this->codesize; offset++) {
             progress(base+offset);
 
             /* Skip but verify blank locations to save time */
             if (buf.isblank(base+offset)) {
-                /* Don't verify the OSCAL location. */
+                /* Don't verify the OSCAL location, nor the locations just
+                 * erased if the erase is trusted: they are skipped over. */
                 if (
                     !((this->flags & PIC_HAS_OSCAL) &&
-                     (offset == this->codesize-1))
+                     (offset == this->codesize-1)) &&
+                    !this->trusted_erase()
                 ) {
+                    this->set_pc(offset);
                     if (
                         diff (
                             buf[base+offset],
@@ -419,16 +522,73 @@ unsigned int offset;
                     }
                 }
             } else {
+                this->set_pc(offset);
                 if (!this->program_one_location((uint32_t)buf[base+offset])) {
                     break;
                 }
             }
-            this->write_command(COMMAND_INC_ADDRESS);
             this->progress_count++;
         }
         if (offset < this->codesize) {
             throw runtime_error("");
         }
+        this->set_pc_end();
+    } catch (std::exception& e) {
+        throw runtime_error (
+            (const char *)Preferences::Name (
+                "Couldn't write program memory at address 0x%04lx",
+                base+offset
+            )
+        );
+    }
+}
+
+void Pic16::write_program_rows(DataBuffer& buf, long base)
+{
+unsigned int offset, count;
+
+    /* The rows can't be verified while they are written */
+    this->progress_total += this->codesize;
+
+    try {
+        for (offset=0; offset < this->codesize; offset += count) {
+            progress(base+offset);
+
+            count = this->codesize - offset;
+            if (count > this->prog_row_size) {
+                count = this->prog_row_size;
+            }
+            this->program_row(buf, base+offset, count);
+            this->progress_count += count;
+        }
+
+        /* Go back to the beginning of program memory and verify it */
+        this->rewind_program_memory();
+
+        for (offset=0; offset < this->codesize; offset++) {
+            progress(base+offset);
+
+            /* Don't verify the blank OSCAL location, nor the locations just
+             * erased if the erase is trusted. */
+            if (
+                !(buf.isblank(base+offset) &&
+                  (this->trusted_erase() ||
+                   ((this->flags & PIC_HAS_OSCAL) &&
+                    (offset == this->codesize-1))))
+            ) {
+                if (
+                    diff (
+                        buf[base+offset],
+                        this->read_prog_data(),
+                        this->wordmask
+                    )
+                ) {
+                    throw runtime_error("");
+                }
+            }
+            this->write_command(COMMAND_INC_ADDRESS);
+            this->progress_count++;
+        }
     } catch (std::exception& e) {
         throw runtime_error (
             (const char *)Preferences::Name (
@@ -439,36 +599,90 @@ unsigned int offset;
     }
 }
 
+void Pic16::program_row(DataBuffer& buf, long base, unsigned int count)
+{
+unsigned int offset;
+bool blank = true;
+
+    for (offset=0; offset < count; offset++) {
+        if (!buf.isblank(base+offset)) {
+            blank = false;
+            break;
+        }
+    }
+    if (blank) {
+        /* Nothing to program, just skip the row: the verify pass reads
+         * it back unless the erase is trusted */
+        for (offset=0; offset < count; offset++) {
+            this->write_command(COMMAND_INC_ADDRESS);
+        }
+        return;
+    }
+    /* Load the write latches, then program them all at once */
+    for (offset=0; offset < count; offset++) {
+        this->write_prog_data((uint32_t)buf[base+offset]);
+        if (offset < count-1) {
+            this->write_command(COMMAND_INC_ADDRESS);
+        }
+    }
+    this->program_row_cycle();
+
+    /* Move to the first location of the next row */
+    this->write_command(COMMAND_INC_ADDRESS);
+}
+
+void Pic16::program_row_cycle(void)
+{
+    this->write_command(COMMAND_BEGIN_PROG);
+    this->io->usleep(this->program_time);
+    if (this->flags & PIC_REQUIRE_EPROG) {
+        this->write_command(COMMAND_END_PROG);
+    }
+}
+
+void Pic16::rewind_program_memory(void)
+{
+    this->set_pc(0);
+}
+
 void Pic16::read_program_memory(DataBuffer& buf, long base, bool verify)
 {
 unsigned int offset;
+uint32_t data;
 
     try {
         for (offset=0; offset < this->codesize; offset++) {
             progress(base+offset);
 
             if (verify) {
-                /* Don't verify the OSCAL location. */
+                /* Don't verify the OSCAL location, nor the blank ones in
+                 * sparse verify mode. */
                 if (
                     !((this->flags & PIC_HAS_OSCAL) &&
-                     (offset == this->codesize-1))
+                     (offset == this->codesize-1)) &&
+                    !(this->sparse_verify && buf.isblank(base+offset))
                 ) {
+                    this->set_pc(offset);
+                    data = this->read_prog_data();
                     if (
-                        diff (
+                        diff(buf[base+offset],data,this->wordmask) &&
+                        !this->mismatch (
+                            base+offset,
+                            this->wordmask,
                             buf[base+offset],
-                            this->read_prog_data(),
-                            this->wordmask
+                            data
                         )
                     ) {
                         throw runtime_error("");
                     }
                 }
             } else {
+                this->set_pc(offset);
                 buf[base+offset] = this->read_prog_data();
             }
-            this->write_command(COMMAND_INC_ADDRESS);
             this->progress_count++;
         }
+        this->set_pc_end();
     } catch (std::exception& e) {
         throw runtime_error (
             (const char *)Preferences::Name (
@@ -481,6 +695,50 @@ unsigned int offset;
     }
 }
 
+void Pic16::blank_check_program_memory(DataBuffer& buf, long base)
+{
+unsigned int offset;
+
+    try {
+        for (offset=0; offset < this->codesize; offset++) {
+            progress(base+offset);
+
+            /* Don't check the OSCAL location. */
+            if (
+                buf.isblank(base+offset) &&
+                !((this->flags & PIC_HAS_OSCAL) &&
+                 (offset == this->codesize-1))
+            ) {
+                this->set_pc(offset);
+                if (
+                    diff (
+                        buf[base+offset],
+                        this->read_prog_data(),
+                        this->wordmask
+                    )
+                ) {
+                    throw runtime_error("");
+                }
+            }
+            this->progress_count++;
+        }
+        this->set_pc_end();
+    } catch (std::exception& e) {
+        throw runtime_error (
+            (const char *)Preferences::Name (
+                "Blank check failed at address 0x%04lx",
+                base+offset
+            )
+        );
+    }
+}
+
+bool Pic16::trusted_erase(void)
+{
+    return this->trust_erase && this->erased &&
+           (this->memtype == MEMTYPE_FLASH);
+}
+
 void Pic16::write_data_memory(DataBuffer& buf, long base)
 {
 unsigned int offset;
@@ -489,11 +747,13 @@ unsigned int offset;
         for (offset=0; offset < this->eesize; offset++) {
             progress(base+offset);
 
-            /* Skip but verify blank locations to save time */
-            if (!diff(buf[base+offset],0xff,0xff)) {
-                if (diff(buf[base+offset],this->read_ee_data(),0xff)) {
-                    break;
-                }
+            /* Skip the locations already holding the value: the read
+             * is the verify too */
+            if (
+                this->can_skip_writes() &&
+                !diff(buf[base+offset],this->read_ee_data(),0xff)
+            ) {
+                this->cells_skipped++;
             } else {
                 this->write_ee_data(buf[base+offset]);
                 this->write_command(COMMAND_BEGIN_PROG);
@@ -501,6 +761,7 @@ unsigned int offset;
                 if (diff(buf[base+offset],this->read_ee_data(),0xff)) {
                     break;
                 }
+                this->cells_written++;
             }
             this->write_command(COMMAND_INC_ADDRESS);
             this->progress_count++;
@@ -521,14 +782,21 @@ unsigned int offset;
 void Pic16::read_data_memory(DataBuffer& buf, long base, bool verify)
 {
 unsigned int offset;
+uint32_t data;
 
     try {
         for (offset=0; offset < this->eesize; offset++) {
             progress(base+offset);
 
             if (verify) {
-                if (diff(buf[base+offset],this->read_ee_data(),0xff)) {
-                    throw runtime_error("");
+                if (!(this->sparse_verify && buf.isblank(base+offset,0xff))) {
+                    data = this->read_ee_data();
+                    if (
+                        diff(buf[base+offset],data,0xff) &&
+                        !this->mismatch(base+offset,0xff,buf[base+offset],data)
+                    ) {
+                        throw runtime_error("");
+                    }
                 }
             } else {
                 buf[base+offset] = this->read_ee_data();
@@ -591,17 +859,21 @@ unsigned int offset;
 void Pic16::read_id_memory(DataBuffer& buf, long base, bool verify)
 {
 unsigned int offset;
+uint32_t data;
 
     try {
         for (offset=0; offset < 4; offset++) {
             progress(base+offset);
 
             if (verify) {
+                data = this->read_prog_data();
                 if (
-                    diff (
+                    diff(buf[base+offset],data,this->wordmask) &&
+                    !this->mismatch (
+                        base+offset,
+                        this->wordmask,
                         buf[base+offset],
-                        this->read_prog_data(),
-                        this->wordmask
+                        data
                     )
                 ) {
                     throw runtime_error("");
@@ -703,7 +975,7 @@ void Pic16::write_ee_data(uint32_t data)
     data = (data & this->wordmask) << 1;
     this->write_command(COMMAND_LOAD_DATA_DATA);
     this->io->shift_bits_out(data, 16, 1);
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly2);
 }
 
 uint32_t Pic16::read_ee_data(void)
@@ -712,7 +984,7 @@ uint32_t data;
 
     this->write_command(COMMAND_READ_DATA_DATA);
     data = this->io->shift_bits_in(16, 0);
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly2);
 
     return (data >> 1) & 0xff;
 }
@@ -734,15 +1006,100 @@ uint32_t Pic16::read_deviceid(void)
 {
 uint32_t devid;
 
-    /* Enter config memory space. The device ID is at address 0x2006 */
-    this->write_command(COMMAND_LOAD_CONFIG);
-    this->io->shift_bits_out(0x7ffe, 16, 1);    /* Dummy write of all 1's */
-    this->io->usleep(1);
+    /* The device ID is at address 0x2006 of the config memory space */
+    this->set_pc(0x2006);
+
+    return read_prog_data();
+}
+
+void Pic16::set_program_mode(void)
+{
+    if (!this->program_mode) {
+        this->pc        = 0;
+        this->pc_config = false;
+    }
+    Pic::set_program_mode();
+}
+
+void Pic16::write_command(uint32_t command)
+{
+    Pic::write_command(command);
+
+    switch (command) {
+        case COMMAND_INC_ADDRESS:
+            this->pc++;
+        break;
+        case COMMAND_LOAD_CONFIG:
+            this->pc        = 0x2000;
+            this->pc_config = true;
+        break;
+        case COMMAND_RESET_ADDRESS:
+            if (this->flags & PIC_FEATURE_LOAD_PC) {
+                this->pc        = 0;
+                this->pc_config = false;
+            }
+        break;
+    }
+}
+
+void Pic16::set_pc(unsigned long addr)
+{
+    this->move_pc(addr, addr >= 0x2000);
+}
+
+void Pic16::set_pc_end(void)
+{
+    this->move_pc(this->codesize, false);
+}
 
-    /* Increment up to 0x2006 */
-    for(int i=0; i < 6; i++) {
+void Pic16::move_pc(unsigned long addr, bool config)
+{
+    if ((config == this->pc_config) && (addr == this->pc)) {
+        return;
+    }
+    if (this->flags & PIC_FEATURE_LOAD_PC) {
+        if (
+            (config != this->pc_config) ||
+            (addr < this->pc) ||
+            (addr - this->pc > PIC16_LOAD_PC_COST)
+        ) {
+            if (addr == 0) {
+                this->write_command(COMMAND_RESET_ADDRESS);
+            } else {
+                this->load_pc_address(addr, config);
+            }
+            return;
+        }
+    } else if ((config != this->pc_config) || (addr < this->pc)) {
+        if (!config || this->pc_config) {
+            /* Re-entering program mode resets the program counter */
+            this->pic_off();
+            this->io->usleep(this->timing.toff);
+            this->set_program_mode();
+        }
+        if (config) {
+            /* Enter config memory space with a dummy write of all 1's */
+            this->write_command(COMMAND_LOAD_CONFIG);
+            this->io->shift_bits_out(0x7ffe, 16, 1);
+            this->io->usleep(this->timing.tdly2);
+        }
+    }
+    while (this->pc < addr) {
         this->write_command(COMMAND_INC_ADDRESS);
     }
-    return read_prog_data();
 }
 
+void Pic16::load_pc_address(unsigned long addr, bool config)
+{
+unsigned long devaddr;
+
+    devaddr = addr;
+    if (config) {
+        devaddr = this->config_base + (addr - 0x2000);
+    }
+    this->write_command(COMMAND_LOAD_PC_ADDRESS);
+    this->io->shift_bits_out((devaddr & 0x3fffff) << 1, 24, 1);
+    this->io->usleep(this->timing.tdly2);
+    this->pc        = addr;
+    this->pc_config = config;
+}
@@ -25,7 +25,7 @@ using namespace std;
 #include "Util.h"
 
 
-Pic16f6xx::Pic16f6xx(char *name) : Pic16(name)
+Pic16f6xx::Pic16f6xx(const DeviceSpec *spec, char *name) : Pic16(spec, name)
 {
 }
 
@@ -41,7 +41,7 @@ void Pic16f6xx::bulk_erase(void)
         /* This clears the config word. XXX: TESTME */
         this->write_command(COMMAND_LOAD_CONFIG);
         this->io->shift_bits_out(0x7ffe, 16, 1);
-        this->io->usleep(1);
+        this->io->usleep(this->timing.tdly2);
         for (int i=0; i<7; i++) {
             this->write_command(COMMAND_INC_ADDRESS);
         }
@@ -24,8 +24,10 @@ using namespace std;
 #include "Microchip.h"
 #include "Util.h"
 
-Pic16f87xA::Pic16f87xA(char *name) : Pic16(name)
+Pic16f87xA::Pic16f87xA(const DeviceSpec *spec, char *name) : Pic16(spec, name)
 {
+    /* Program memory is written 8 words at a time */
+    this->prog_row_size = 8;
 }
 
 
@@ -42,7 +44,7 @@ void Pic16f87xA::disable_codeprotect(void)
          * erased. */
         this->write_command(COMMAND_LOAD_CONFIG);
         this->io->shift_bits_out(0x7ffe, 16, 1);
-        this->io->usleep(1);
+        this->io->usleep(this->timing.tdly2);
 
         this->write_command(COMMAND_CHIP_ERASE);
         this->io->usleep(this->erase_time);
@@ -59,46 +61,14 @@ void Pic16f87xA::bulk_erase(void)
     this->disable_codeprotect();
 }
 
-/* ignores program_count and program_multiplier. no verify is done on data */
-void Pic16f87xA::write_program_memory(DataBuffer& buf, long base)
+/* Program the 8 loaded write latches. Ignores program_count and
+ * program_multiplier. */
+void Pic16f87xA::program_row_cycle(void)
 {
-unsigned int offset;
-
-    if ((base % 8) != 0) {
-        throw runtime_error (
-            (const char *)Preferences::Name (
-                "Base address doesn't fall on 3-bit boundary, 0x%04lx",
-                base
-            )
-        );
-    }
-
-    try {
-        for (offset=0; offset < this->codesize; offset++) {
-            progress(base+offset);
-
-            this->write_prog_data((uint32_t)buf[base+offset]);
-            /* 8 words loaded, now program it. */
-            if (((offset+base) % 8) == 7) {
-                this->write_command(COMMAND_BEGIN_PROG);
-                this->io->usleep(this->program_time);
-                if (this->flags & PIC_REQUIRE_EPROG) {
-                    this->write_command(COMMAND_END_PROG);
-                }
-            }
-            this->write_command(COMMAND_INC_ADDRESS);
-            this->progress_count++;
-        }
-        if (offset < this->codesize) {
-            throw runtime_error("");
-        }
-    } catch (std::exception& e) {
-        throw runtime_error (
-            (const char *)Preferences::Name (
-                "Couldn't write program memory at address 0x%04lx",
-                base + offset
-            )
-        );
+    this->write_command(COMMAND_BEGIN_PROG);
+    this->io->usleep(this->program_time);
+    if (this->flags & PIC_REQUIRE_EPROG) {
+        this->write_command(COMMAND_END_PROG);
     }
 }
 
@@ -25,7 +25,9 @@ using namespace std;
 #include "Microchip.h"
 #include "Util.h"
 
-Pic16f88x::Pic16f88x(char *name) : Pic16(name)
+#define ERASE_ROW_SIZE 16  /* Words erased by COMMAND_ERASE_PROG_ROW */
+
+Pic16f88x::Pic16f88x(const DeviceSpec *spec, char *name) : Pic16(spec, name)
 {
     this->program_time += 100;
     this->flags |= PIC_HAS_OSCAL;
@@ -37,6 +39,9 @@ Pic16f88x::Pic16f88x(char *name) : Pic16(name)
     // Check and constrain value of write_buffer_size
     if ( (write_buffer_size != 4) && (write_buffer_size != 8) )
     	write_buffer_size = 4;
+
+    // Program memory is written 4 or 8 words at a time
+    this->prog_row_size = write_buffer_size;
 }
 
 Pic16f88x::~Pic16f88x()
@@ -63,7 +68,7 @@ void	Pic16f88x::erase(void)
          * protection needs to be disabled. */
         this->write_command(COMMAND_LOAD_CONFIG);
         this->io->shift_bits_out(0x7ffe, 16, 1);   /* Dummy write of all 1's */
-        this->io->usleep(1);
+        this->io->usleep(this->timing.tdly2);
         /* Pic address is 0x2000
 
         /* Skip to the configuration word(s) */
@@ -94,7 +99,7 @@ void	Pic16f88x::erase(void)
         throw;
     }
     /* Wait a bit after exiting program mode */
-    this->io->usleep(10000);
+    this->io->usleep(this->timing.toff);
 
 	/* Code protection prevents code memory from being read.  Code memory gets 
 	 * erased by the Bulk Erase Program Memory command regardless of the CP bit
@@ -110,7 +115,7 @@ void	Pic16f88x::erase(void)
 		// Erase program memory unconditionally, including user ID words
 		this->write_command(COMMAND_LOAD_CONFIG);
 		this->io->shift_bits_out(0x7ffe, 16, 1);
-		this->io->usleep(1);
+		this->io->usleep(this->timing.tdly2);
 		this->write_command(COMMAND_ERASE_PROG_MEM);
 		this->io->usleep(this->erase_time);
 
@@ -130,7 +135,7 @@ void	Pic16f88x::erase(void)
 	/* Check if we need to restore some state. */
 	if ((this->persistent_config_mask != 0) || (this->flags & PIC_HAS_OSCAL)) {
 		/* Wait a bit after exiting program mode */
-		this->io->usleep(10000);
+		this->io->usleep(this->timing.toff);
 
 		try {
 	    	unsigned int	c_addr = 0x2000;
@@ -140,7 +145,7 @@ void	Pic16f88x::erase(void)
 			/* Read the OSCAL value and compare it to the saved value	*/
 	        this->write_command(COMMAND_LOAD_CONFIG);
     	    this->io->shift_bits_out(0x7ffe, 16, 1);   /* Dummy write of all 1's */
-        	this->io->usleep(1);
+        	this->io->usleep(this->timing.tdly2);
 	        /* Pic address is 0x2000
 
     	    /* Skip to the calibration word */
@@ -188,7 +193,7 @@ void	Pic16f88x::erase(void)
 
 					/* Dummy write of all 1's */
 					this->io->shift_bits_out(0x7ffe, 16, 1);
-					this->io->usleep(1);
+					this->io->usleep(this->timing.tdly2);
 
 					/* Skip to the configuration word */
 					for (int i=0; i < 7; i++) {
@@ -215,97 +220,227 @@ void	Pic16f88x::erase(void)
             throw;
         }
     }
+    this->erased = true;
 }
 
-/* Use 4- or 8-word algorithm to write all of program memory.  Do a verify 
- * afterwards, taking advantage of the fact that the address will alias to 
- * PC = 0 after programming highest address or wrap to PC = 0 if 
- * codesize = 0x1FFF).  Verify of the write has to be done after finishing all
- * of program memory, since the PC can't be decremented.
- */
-void Pic16f88x::write_program_memory(DataBuffer& buf, long base)
+void Pic16f88x::reprogram(DataBuffer& buf, DataBuffer *current)
 {
-	unsigned int offset;
-	
-	// Do this because we can't verify as we write with multi-word programming.
-	this->progress_total += this->codesize;
+DataBuffer device(this->wordsize);
+vector<bool> changed_rows;
+unsigned int offset, count, i, ids;
+uint32_t data;
+bool changed;
+
+    if (this->memtype != MEMTYPE_FLASH) {
+        throw runtime_error("Operation not supported by device");
+    }
+    if (this->io->gang_targets() > 1) {
+        /* The other bit-parallel targets may hold something else */
+        Device::reprogram(buf, current);
+        return;
+    }
+    if (current == NULL) {
+        /* Read what the device contains to compare with it */
+        this->read(device);
+        current = &device;
+    }
+    ids = (this->flags & PIC_FEATURE_BKBUG) ? 5 : 4;
+
+    /* Without a bulk erase, the ID and configuration bits can only be
+     * cleared. A protected device reads back as 0 and must be erased too. */
+    changed = ((*current)[0x2007] & this->cp_mask) != this->cp_none;
+    if (this->flags & PIC_FEATURE_EEPROM) {
+        changed |= ((*current)[0x2007] & this->cpd_mask) != this->cpd_off;
+    }
+    for (i=0; i < ids; i++) {
+        if (buf[0x2000+i] & ~(*current)[0x2000+i] & this->wordmask) {
+            changed = true;
+        }
+    }
+    for (i=0; i < this->config_words; i++) {
+        data  = buf[0x2007+i] & ~this->persistent_config_mask[i];
+        data |= (*current)[0x2007+i] & this->persistent_config_mask[i];
+        if (data & ~(*current)[0x2007+i] & this->config_mask[i]) {
+            changed = true;
+        }
+    }
+    if (changed) {
+        this->erase();
+        this->program(buf);
+        return;
+    }
+
+    /* Program memory is written and then verified */
+    this->progress_total = 2*this->codesize + this->eesize +
+                           this->config_words + ids;
+    this->progress_count = 0;
+    this->cells_written  = 0;
+    this->cells_skipped  = 0;
+    offset = 0;
 
     try {
-    	// Write all of program memory, 4 or 8 bytes at a time
-		for (offset = 0; offset < this->codesize; 
-										offset += this->write_buffer_size) {
-			program_mult_prog_loc(buf, offset);
-			this->progress_count += this->write_buffer_size;
-			progress(base+offset);
-		}
-    	
-    	// Now, go back and verify the write.  The PC will be 0 or aliased to 0.
+        this->set_program_mode();
+
+        /* Erase and write again the changed rows, skip the others */
+        for (offset=0; offset < this->codesize; offset += count) {
+            progress(offset);
+
+            count = this->codesize - offset;
+            if (count > ERASE_ROW_SIZE) {
+                count = ERASE_ROW_SIZE;
+            }
+            changed = false;
+            for (i=0; i < count; i++) {
+                if (diff(buf[offset+i],(*current)[offset+i],this->wordmask)) {
+                    changed = true;
+                    break;
+                }
+            }
+            changed_rows.push_back(changed);
+            if (changed) {
+                this->write_command(COMMAND_ERASE_PROG_ROW);
+                this->io->usleep(this->erase_time);
+                for (i=0; i < count; i += this->prog_row_size) {
+                    this->program_row (
+                        buf,
+                        offset+i,
+                        (count-i < this->prog_row_size) ? count-i
+                                                        : this->prog_row_size
+                    );
+                }
+            } else {
+                for (i=0; i < count; i++) {
+                    this->write_command(COMMAND_INC_ADDRESS);
+                }
+            }
+            this->progress_count += count;
+        }
+
+        /* Go back to the beginning and verify the rows just written */
+        this->rewind_program_memory();
+
         for (offset=0; offset < this->codesize; offset++) {
-        	if (diff(buf[base+offset], this->read_prog_data(), this->wordmask ))
-        		throw runtime_error("");
-        	
-            progress(base+offset);
+            progress(offset);
+
+            if (
+                changed_rows[offset / ERASE_ROW_SIZE] &&
+                !(buf.isblank(offset) &&
+                  (this->flags & PIC_HAS_OSCAL) &&
+                  (offset == this->codesize-1))
+            ) {
+                if (diff(buf[offset],this->read_prog_data(),this->wordmask)) {
+                    throw runtime_error (
+                        (const char *)Preferences::Name (
+                            "Couldn't write program memory at address 0x%04lx",
+                            (unsigned long)offset
+                        )
+                    );
+                }
+            }
+            this->write_command(COMMAND_INC_ADDRESS);
+            this->progress_count++;
+        }
+
+        /* Write the changed data EEPROM bytes */
+        if (this->flags & PIC_FEATURE_EEPROM) {
+            this->write_data_memory(buf, 0x2100);
+        }
+
+        /* Write the changed ID locations */
+        this->write_command(COMMAND_LOAD_CONFIG);
+        this->io->shift_bits_out(0x7ffe, 16, 1);
+        this->io->usleep(this->timing.tdly2);
+        for (i=0; i < ids; i++) {
+            progress(0x2000+i);
+            if (diff(buf[0x2000+i],(*current)[0x2000+i],this->wordmask)) {
+                if (!this->program_one_location((uint32_t)buf[0x2000+i])) {
+                    throw runtime_error (
+                        (const char *)Preferences::Name (
+                            "Couldn't write ID memory at address 0x%04lx",
+                            0x2000UL+i
+                        )
+                    );
+                }
+            }
             this->write_command(COMMAND_INC_ADDRESS);
             this->progress_count++;
         }
+        /* Skip to the config words */
+        for (i=ids; i < 7; i++) {
+            this->write_command(COMMAND_INC_ADDRESS);
+        }
+        /* Write the changed config words, keeping the persistent bits */
+        for (i=0; i < this->config_words; i++) {
+            data  = buf[0x2007+i] & ~this->persistent_config_mask[i];
+            data |= (*current)[0x2007+i] & this->persistent_config_mask[i];
+            if (diff(data,(*current)[0x2007+i],this->config_mask[i])) {
+                this->write_config_word(data);
+                this->cells_written++;
+            } else {
+                this->cells_skipped++;
+            }
+            this->write_command(COMMAND_INC_ADDRESS);
+            this->progress_count++;
+            progress(0x2007 + i);
+        }
+        this->erased = false;
+
+        this->pic_off();
     } catch (std::exception& e) {
-        throw runtime_error (
-            (const char *)Preferences::Name (
-                "Couldn't write program memory at address 0x%04lx",
-                base+offset
-            )
-        );
+        this->erased = false;
+        this->pic_off();
+        throw;
     }
 }
 
-/* Write 4 or 8 program memory locations using the appropriate algorithm.  If
- * all the locations in the buffer are blank, skip the programming command.	*/
-void Pic16f88x::program_mult_prog_loc(DataBuffer& buf, long base)
+// The rows are erased, so all the bits can be repaired: no need to use
+// the Pic16 method based on program_one_location()
+bool Pic16f88x::repair(DataBuffer& buf, MismatchVector& result)
 {
-	unsigned int	offset;
-	bool			do_prog = false;
-	
-	// Write 3 or 7 bytes to the write buffers
-	for (offset = 0; offset < this->write_buffer_size - 1; offset++) {
-		this->write_prog_data(buf[base + offset]);	
-		this->write_command(COMMAND_INC_ADDRESS);
-		if ( !buf.isblank(base+offset) ) do_prog = true;
-	}
-	// Write 4th or 8th byte, then issue program command
-	this->write_prog_data(buf[base + offset]);
-	if ( !buf.isblank(base+offset) ) do_prog = true;
-	if (do_prog) {
-	    if (this->flags & PIC_REQUIRE_EPROG) {
-			this->write_command(COMMAND_BEGIN_PROG_EXT);
-	    } else {
-			this->write_command(COMMAND_BEGIN_PROG);
-	    }
-		this->io->usleep(this->program_time);
-	    if (this->flags & PIC_REQUIRE_EPROG) {
-        	this->write_command(COMMAND_END_PROG);
-        	this->io->usleep(100);					// discharge time
-    	}
-	}
-    // Increment to next PC location before exiting
-    this->write_command(COMMAND_INC_ADDRESS);
+    return Device::repair(buf, result);
 }
 
-// Different from Pic16 method: needs end-programming command and discharge time 
-void Pic16f88x::write_data_memory(DataBuffer& buf, long base)
+/* The PC aliases to 0 after programming the highest address (or wraps to
+ * PC = 0 if codesize = 0x1FFF), so the verify pass of the row writer can
+ * start without leaving program mode.
+ */
+void Pic16f88x::rewind_program_memory(void)
 {
+}
+
+/* Program the 4 or 8 loaded write latches using the appropriate algorithm */
+void Pic16f88x::program_row_cycle(void)
+{
+    if (this->flags & PIC_REQUIRE_EPROG) {
+        this->write_command(COMMAND_BEGIN_PROG_EXT);
+    } else {
+        this->write_command(COMMAND_BEGIN_PROG);
+    }
+    this->io->usleep(this->program_time);
+    if (this->flags & PIC_REQUIRE_EPROG) {
+        this->write_command(COMMAND_END_PROG);
+        this->io->usleep(this->timing.tdis);    // discharge time
+    }
+}
+
+// Different from Pic16 method: needs end-programming command and discharge time 
+void Pic16f88x::write_data_memory (
+    DataBuffer& buf,
+    long base
+) {
 unsigned int offset;
 
     try {
         for (offset=0; offset < this->eesize; offset++) {
         	unsigned int tmp;
 
-           	tmp = buf[base+offset];
-
-            /* Skip but verify blank locations to save time */
-            if (!diff(buf[base+offset],0xff,0xff)) {
-                if (diff(tmp,this->read_ee_data(),0xff)) {
-                    break;
-                }
+            /* Skip the locations already holding the value: the read
+             * is the verify too */
+            if (
+                this->can_skip_writes() &&
+                !diff(buf[base+offset],this->read_ee_data(),0xff)
+            ) {
+                this->cells_skipped++;
             } else {
                 this->write_ee_data(buf[base+offset]);
 			    if (this->flags & PIC_REQUIRE_EPROG) {
@@ -316,11 +451,12 @@ unsigned int offset;
                 this->io->usleep(this->program_time);
 			    if (this->flags & PIC_REQUIRE_EPROG) {
         			this->write_command(COMMAND_END_PROG);
-                	this->io->usleep(100);	// Discharge time
+                	this->io->usleep(this->timing.tdis);	// Discharge time
 			    }
                 tmp = this->read_ee_data();
                 if (diff(buf[base+offset],tmp,0xff))
                     throw runtime_error("");
+                this->cells_written++;
             }
             this->write_command(COMMAND_INC_ADDRESS);
             this->progress_count++;
@@ -347,7 +483,7 @@ bool Pic16f88x::program_cycle(uint32_t data, uint32_t mask)
     this->io->usleep(this->program_time);
     if (this->flags & PIC_REQUIRE_EPROG) {
         this->write_command(COMMAND_END_PROG);
-        this->io->usleep(100);
+        this->io->usleep(this->timing.tdis);
     }
     if ((read_prog_data() & mask) == (data & mask)) {
         return true;
@@ -25,7 +25,7 @@ using namespace std;
 #include "Util.h"
 
 
-Pic16f8xx::Pic16f8xx(char *name) : Pic16(name)
+Pic16f8xx::Pic16f8xx(const DeviceSpec *spec, char *name) : Pic16(spec, name)
 {
     this->program_time += 100;
 }
@@ -42,7 +42,7 @@ void Pic16f8xx::bulk_erase(void)
         /* This clears program memory and the config word. */
         this->write_command(COMMAND_LOAD_CONFIG);
         this->io->shift_bits_out(0x7ffe, 16, 1);
-        this->io->usleep(1);
+        this->io->usleep(this->timing.tdly2);
         for (int i=0; i<7; i++) {
             this->write_command(COMMAND_INC_ADDRESS);
         }
@@ -77,7 +77,7 @@ void Pic16f8xx::disable_codeprotect(void)
 
         this->write_command(COMMAND_LOAD_CONFIG);
         this->io->shift_bits_out(0x7ffe, 16, 1);
-        this->io->usleep(1);
+        this->io->usleep(this->timing.tdly2);
         for (int i=0; i<7; i++) {
             this->write_command(COMMAND_INC_ADDRESS);
         }
@@ -27,6 +27,7 @@ using namespace std;
 
 #define PANEL_SHIFT 13
 #define PANELSIZE (1 << PANEL_SHIFT) /* bytes */
+#define BLOCKSIZE 64                 /* bytes erased by block_erase() */
 
 const Instruction Pic18::opcodes[] = {
     /* PIC 16-bit "Special" instruction set */
@@ -157,20 +158,43 @@ const Instruction Pic18::opcodes[] = {
 #define EEPROM_ADDR    (0xf00000/2)
 #define EEPROM_WRDS    (this->eesize/2)
 
-Pic18::Pic18(char *name) : Pic(name)
+/* Tells if the 8 bytes (a write buffer) at byte address addr are blank */
+static bool blank_row(DataBuffer& buf, unsigned long addr)
+{
+int i;
+
+    for (i=0; i<4; i++) {
+        if (!buf.isblank(addr/2 + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Pic18::Pic18(const DeviceSpec *spec, char *name) : Pic(spec, name)
 {
 int i;
 
     this->popcodes = this->opcodes;
+    this->pdecode  = Pic::decoder(this->opcodes);
+
+    this->tblptr       = 0;
+    this->tblptr_valid = false;
+    this->eeadr        = 0;
+    this->eeadr_valid  = false;
+    this->has_eeadrh   = true;
+
+    /* PIC18 high voltage discharge time (P10) */
+    spec->get("tDIS",(int &)this->timing.tdis,5);
 
     /* Read in config bits */
     for (i=0; i<CFG_WORDS_WRDS; i++) {
-        config->getHex (
+        spec->getHex (
             Preferences::Name("cw_mask_%02d", i), 
             (int &)config_masks[i], 
             0xffff
         );
-        config->getHex (
+        spec->getHex (
             Preferences::Name("cw_defs_%02d", i), 
             (int &)config_deflt[i], 
             0xffff
@@ -316,6 +340,8 @@ void Pic18::program(DataBuffer& buf)
     /* Progress_total is x2 because we write and verify every location */
     this->progress_total = 2 * (this->codesize + 4 + 7 + this->eesize) - 1;
     this->progress_count = 0;
+    this->cells_written  = 0;
+    this->cells_skipped  = 0;
     try {
         set_program_mode();
 
@@ -333,9 +359,112 @@ void Pic18::program(DataBuffer& buf)
     }
 }
 
+void Pic18::reprogram(DataBuffer& buf, DataBuffer *current)
+{
+DataBuffer device(16);
+unsigned long addr, start, len;
+unsigned int i;
+bool changed;
+
+    if (this->memtype != MEMTYPE_FLASH) {
+        throw runtime_error("Operation not supported by device");
+    }
+    if (this->io->gang_targets() > 1) {
+        /* The other bit-parallel targets may hold something else */
+        Device::reprogram(buf, current);
+        return;
+    }
+    if (current == NULL) {
+        /* Read what the device contains to compare with it */
+        this->read(device);
+        current = &device;
+    }
+    /* The ID locations can't be erased alone, so a bit going from 0 to 1
+     * needs a chip erase. The same if the code is protected (config words
+     * 5 to 7: a cleared bit protects a block): the blocks read back as 0
+     * and can't be erased one by one. */
+    changed = false;
+    for (i=0; i<ID_LOC_WRDS; i++) {
+        if (buf[ID_LOC_ADDR+i] & ~(*current)[ID_LOC_ADDR+i] & 0xffff) {
+            changed = true;
+        }
+    }
+    for (i=4; i<CFG_WORDS_WRDS; i++) {
+        if (~(*current)[CFG_WORDS_ADDR+i] & this->config_masks[i]) {
+            changed = true;
+        }
+    }
+    if (changed) {
+        this->erase();
+        this->program(buf);
+        return;
+    }
+
+    /* Progress_total is x2 because we write and verify every location */
+    this->progress_total = 2 * (this->codesize + 4 + 7 + this->eesize) - 1;
+    this->progress_count = 0;
+    this->cells_written  = 0;
+    this->cells_skipped  = 0;
+    try {
+        set_program_mode();
+
+        /* Erase and write again each run of changed blocks */
+        start = 0;
+        len = 0;
+        for (addr=0; addr <= (this->codesize*2); addr+=BLOCKSIZE) {
+            changed = false;
+            for (i=0; (addr < (this->codesize*2)) && (i < BLOCKSIZE/2); i++) {
+                if (diff(buf[addr/2+i],(*current)[addr/2+i],0xffff)) {
+                    changed = true;
+                    break;
+                }
+            }
+            if (changed) {
+                if (len == 0) {
+                    start = addr;
+                }
+                len += BLOCKSIZE;
+                continue;
+            }
+            if (len > 0) {
+                block_erase(len, start);
+                write_program_rows(buf, start, len, true);
+                len = 0;
+            }
+            if (addr < (this->codesize*2)) {
+                /* Unchanged block: it counts as written and verified */
+                this->progress_count += BLOCKSIZE;
+                progress(addr);
+            }
+        }
+
+        /* Bits can be cleared in the ID locations without erasing them */
+        changed = false;
+        for (i=0; i<ID_LOC_WRDS; i++) {
+            if (diff(buf[ID_LOC_ADDR+i],(*current)[ID_LOC_ADDR+i],0xffff)) {
+                changed = true;
+            }
+        }
+        if (changed) {
+            write_id_memory(buf, 0x200000, true);
+        } else {
+            this->progress_count += 2 * ID_LOC_WRDS;
+        }
+        if (flags & PIC_FEATURE_EEPROM) {
+            write_data_memory(buf, 0xf00000, true);
+        }
+        write_config_memory(buf, 0x300000, true);
+
+        pic_off();
+    } catch (std::exception& e) {
+        pic_off();
+        throw;
+    }
+}
+
 void Pic18::write_program_memory(DataBuffer& buf, bool verify)
 {
-unsigned int npanels, panel, offset;
+unsigned int npanels, panel, offset, last;
 
     panel = 0;
     offset = 0;
@@ -350,19 +479,44 @@ unsigned int npanels, panel, offset;
         write_command(COMMAND_CORE_INSTRUCTION, ASM_BCF_EECON1_CFGS);
 
         for (offset=0; offset < PANELSIZE; offset+=8) {
+            /* Blank panel rows are left out: find the last one to load,
+             * which starts the write */
+            last = npanels;
+            for (panel=0; panel<npanels; panel++) {
+                if (!blank_row(buf, (panel << PANEL_SHIFT) + offset)) {
+                    last = panel;
+                }
+            }
+            if (last == npanels) {
+                /* Nothing to write in any panel, skip the whole cycle */
+                this->progress_count += (verify ? 8 : 4) * npanels;
+                continue;
+            }
+
             /* Step 3,4,5,6: Load write buffer for Panel 1,2,3,4 */
-            for (panel=0; panel<npanels-1; panel++) {
+            for (panel=0; panel<=last; panel++) {
+                if (
+                    (panel < last) &&
+                    blank_row(buf, (panel << PANEL_SHIFT) + offset)
+                ) {
+                    this->progress_count += 4;
+                    continue;
+                }
                 /* Give byte addresses to progress() to match datasheet. */
                 progress((panel << PANEL_SHIFT) + offset);
-                load_write_buffer(buf, panel, offset, false);
+                load_write_buffer(buf, panel, offset, panel == last);
             }
-            load_write_buffer(buf, panel, offset, true);
+            this->progress_count += 4 * (npanels - 1 - last);
 
             program_delay();
 
             if (verify) {
                 /* Verify the memory just written */
                 for (panel=0; panel<npanels; panel++) {
+                    if (blank_row(buf, (panel << PANEL_SHIFT) + offset)) {
+                        this->progress_count += 4;
+                        continue;
+                    }
                     progress((panel << PANEL_SHIFT) + offset);
                     /* Verify the 4 words per panel */
                     read_memory(buf, (panel << PANEL_SHIFT) + offset, 4, true);
@@ -380,6 +534,54 @@ unsigned int npanels, panel, offset;
     }
 }
 
+void Pic18::write_program_rows (
+    DataBuffer& buf,
+    unsigned long addr,
+    unsigned long len,
+    bool verify
+) {
+unsigned long offset;
+
+    offset = addr;
+    try {
+        /* Step 1: Configure device for single panel writes */
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_EEPGD);
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_CFGS);
+        set_tblptr(0x3c0006);
+        write_command(COMMAND_TABLE_WRITE, 0x0000);
+
+        /* Step 2: Direct access to code memory */
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_EEPGD);
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_BCF_EECON1_CFGS);
+
+        for (offset=addr; offset < (addr+len); offset+=8) {
+            progress(offset);
+
+            /* Step 3: Load the write buffer and write it, unless it's
+             * blank: the range has just been erased */
+            if (blank_row(buf, offset)) {
+                this->progress_count += 4;
+            } else {
+                load_write_buffer(buf, offset/PANELSIZE, offset%PANELSIZE, true);
+                program_delay();
+            }
+        }
+        if (verify) {
+            /* Verify the memory just written */
+            offset = addr;
+            read_memory(buf, addr, len/2, true);
+        }
+    } catch (std::exception& e) {
+        throw runtime_error (
+            (const char *)Preferences::Name (
+                "Couldn't write program memory at address 0x%06lx: %s",
+                offset,
+                e.what()
+            )
+        );
+    }
+}
+
 void Pic18::write_id_memory (
     DataBuffer& buf,
     unsigned long addr,
@@ -426,6 +628,8 @@ void Pic18::write_data_memory (
 uint32_t ins;
 uint8_t data;
 unsigned int offset;
+bool same;
+IO::GangRead mode;
 
     offset = 0;
     try {
@@ -437,64 +641,56 @@ unsigned int offset;
             progress(addr+(2*offset));
 
             /* Step 2: Set the data EEPROM address pointer */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(offset & 0xff));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADR));
-            ins = ASM_MOVLW((offset >> 8) & 0xff);
-            write_command(COMMAND_CORE_INSTRUCTION, ins);
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADRH));
-
-            /* Step 3: Load the data to be written */
-            if ((offset & 1) == 0) {
-                data = buf[(addr+offset)/2] & 0xff;
+            set_eeadr(offset);
+
+            /* Read the cell first: if it already holds the data, it isn't
+             * written again (and the read verifies it) */
+            data = get_ee_byte(buf, addr, offset);
+            same = this->can_skip_writes() && (read_ee_byte() == data);
+            if (same) {
+                this->cells_skipped++;
             } else {
-                data = (buf[(addr+offset)/2] >> 8) & 0xff;
-            }
-            ins = ASM_MOVLW(data);
-            write_command(COMMAND_CORE_INSTRUCTION, ins);
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEDATA));
+                this->cells_written++;
+
+                /* Step 3: Load the data to be written */
+                ins = ASM_MOVLW(data);
+                write_command(COMMAND_CORE_INSTRUCTION, ins);
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEDATA));
 
-            /* Step 4: Enable memory writes */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_WREN);
+                /* Step 4: Enable memory writes */
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_WREN);
 
-            /* Step 5: Perform required sequence */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(0x55));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EECON2));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(0xaa));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EECON2));
+                /* Step 5: Perform required sequence */
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(0x55));
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EECON2));
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(0xaa));
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EECON2));
 
-            /* Step 6: Initiate write */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_WR);
+                /* Step 6: Initiate write */
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_WR);
 
-            /* Step 7: Poll WR bit, repeat until the bit is clear */
-            do {
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EECON1_W_0);
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
+                /* Step 7: Poll WR bit, repeat until the bit is clear on
+                 * all the bit-parallel targets */
+                mode = this->gang_read(IO::GANG_READ_ANY);
+                do {
+                    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EECON1_W_0);
+                    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
 
-                ins = write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
-            } while (ins & 0x02);
+                    ins = write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
+                } while (ins & 0x02);
+                this->gang_read(mode);
 
-            /* Step 8: Disable writes */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_BCF_EECON1_WREN);
+                /* Step 8: Disable writes */
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_BCF_EECON1_WREN);
 
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_NOP);
-            program_delay(false);
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_NOP);
+                program_delay(false);
+            }
 
             this->progress_count++;
 
             if (verify) {
-                /* Initiate a memory read */
-                /* BSF EECON1, RD */
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
-
-                /* Load data into the serial data holding register */
-                /* MOVF EEDATA, W, 0 */
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EEDATA_W_0);
-                /* MOVWF TABLAT */
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
-
-                /* Shift out data and check */
-                ins = write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
-                if (ins != data) {
+                if (!same && (read_ee_byte() != data)) {
                     throw runtime_error("");
                 }
                 this->progress_count++;
@@ -515,6 +711,7 @@ void Pic18::write_config_memory (
     unsigned long addr,
     bool verify
 ) {
+unsigned int changes;
 int i;
 
     i = 0;
@@ -533,14 +730,18 @@ int i;
             progress(addr);
 
             /* Step 3: Set Table Pointer for config byte to be written. Write
-             * even/odd addresses */
+             * even/odd addresses, skipping the bytes already programmed */
+            changes = read_config_changes(buf, addr, config_masks[i]);
             set_tblptr(addr);
-            write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff);
-            program_delay();
-
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_TBLPTR);
-            write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff00);
-            program_delay();
+            if (changes & 0x00ff) {
+                write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff);
+                program_delay();
+            }
+            if (changes & 0xff00) {
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_TBLPTR);
+                write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff00);
+                program_delay();
+            }
 
             this->progress_count++;
             if (verify) {
@@ -588,17 +789,29 @@ void Pic18::read_memory (
 unsigned int data;
 
     try {
-        set_tblptr(addr);
         addr >>= 1;         /* Shift to word addresses */
         while (len > 0) {
             /* Give byte addresses to progress() to match datasheet. */
             progress(addr*2);
 
+            if (verify && this->sparse_verify && buf.isblank(addr,0xffff)) {
+                /* Skip the blank word: TBLPTR is loaded again only when
+                 * the next populated word is reached */
+                addr++;
+                len--;
+                this->progress_count++;
+                continue;
+            }
+
             /* Read memory a byte at a time (little endian format) */
+            set_tblptr(addr*2);
             data  = write_command_read_data(COMMAND_TABLE_READ_POSTINC);
             data |= (write_command_read_data(COMMAND_TABLE_READ_POSTINC) << 8);
             if (verify) {
-                if (diff(buf[addr],data,0x0000ffff)) {
+                if (
+                    diff(buf[addr],data,0x0000ffff) &&
+                    !this->mismatch(addr,0xffff,buf[addr],data)
+                ) {
                     throw runtime_error("");
                 }
             } else {
@@ -644,7 +857,15 @@ unsigned long i;
             data |= (write_command_read_data(COMMAND_TABLE_READ_POSTINC) << 8);
 
             if (verify) {
-                if (diff(buf[addr],data,this->config_masks[cword_num])) {
+                if (
+                    diff(buf[addr],data,this->config_masks[cword_num]) &&
+                    !this->mismatch (
+                        addr,
+                        this->config_masks[cword_num],
+                        buf[addr],
+                        data
+                    )
+                ) {
                     throw runtime_error("");
                 }
             } else {
@@ -672,7 +893,6 @@ void Pic18::read_data_memory (
     unsigned long addr,
     bool verify
 ) {
-uint32_t ins;
 unsigned int offset, data = 0;
 
     offset = 0;
@@ -685,13 +905,17 @@ unsigned int offset, data = 0;
             /* Give byte addresses to progress() to match datasheet. */
             progress(addr+offset);
 
+            if (
+                verify && this->sparse_verify &&
+                (get_ee_byte(buf, addr, offset) == 0xff)
+            ) {
+                /* Blank byte: set_eeadr() jumps past it */
+                this->progress_count++;
+                continue;
+            }
+
             /* Set the data EEPROM address pointer */
-            ins = ASM_MOVLW(offset & 0xff);
-            write_command(COMMAND_CORE_INSTRUCTION, ins);
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADR));
-            ins = ASM_MOVLW((offset >> 8) & 0xff);
-            write_command(COMMAND_CORE_INSTRUCTION, ins);
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADRH));
+            set_eeadr(offset);
 
             /* Initiate a memory read */
             write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
@@ -705,11 +929,27 @@ unsigned int offset, data = 0;
             if (verify) {
                 /* The data is packed 2 bytes per word, little endian */
                 if ((offset & 1) == 0) {
-                    if (diff(data,buf[(addr + offset)/2],0xff)) {
+                    if (
+                        diff(data,buf[(addr + offset)/2],0xff) &&
+                        !this->mismatch (
+                            (addr + offset)/2,
+                            0x00ff,
+                            buf[(addr + offset)/2],
+                            data
+                        )
+                    ) {
                         throw runtime_error("");
                     }
                 } else {
-                    if (diff(data,(buf[(addr + offset)/2] >> 8),0xff)) {
+                    if (
+                        diff(data,(buf[(addr + offset)/2] >> 8),0xff) &&
+                        !this->mismatch (
+                            (addr + offset)/2,
+                            0xff00,
+                            buf[(addr + offset)/2],
+                            data << 8
+                        )
+                    ) {
                         throw runtime_error("");
                     }
                 }
@@ -762,6 +1002,59 @@ int i;
     this->progress_count++;
 }
 
+unsigned int Pic18::read_config_changes (
+    DataBuffer& buf,
+    unsigned long addr,
+    unsigned int mask
+) {
+unsigned int data, changes;
+
+    if (this->can_skip_writes()) {
+        set_tblptr(addr);
+        data  = write_command_read_data(COMMAND_TABLE_READ_POSTINC);
+        data |= (write_command_read_data(COMMAND_TABLE_READ_POSTINC) << 8);
+
+        changes = (data ^ buf[addr/2]) & mask;
+    } else {
+        changes = mask;
+    }
+    for (int i=0; i<2; i++) {
+        if ((mask >> (8*i)) & 0xff) {
+            if ((changes >> (8*i)) & 0xff) {
+                this->cells_written++;
+            } else {
+                this->cells_skipped++;
+            }
+        }
+    }
+    return changes;
+}
+
+unsigned int Pic18::read_ee_byte(void)
+{
+    /* Initiate a memory read */
+    write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
+
+    /* Load data into the serial data holding register */
+    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EEDATA_W_0);
+    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
+
+    /* Shift out data */
+    return write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
+}
+
+uint8_t Pic18::get_ee_byte (
+    DataBuffer& buf,
+    unsigned long addr,
+    unsigned int offset
+) {
+    /* The data is packed 2 bytes per word, little endian */
+    if ((offset & 1) == 0) {
+        return buf[(addr+offset)/2] & 0xff;
+    }
+    return (buf[(addr+offset)/2] >> 8) & 0xff;
+}
+
 void Pic18::program_delay(bool hold_clock_high)
 {
     this->io->shift_bits_out(0x00, BITS_AND_CLK(4,hold_clock_high));
@@ -769,43 +1062,145 @@ void Pic18::program_delay(bool hold_clock_high)
     if (hold_clock_high) {
         this->io->clock(false);
     }
-    this->io->usleep(5);    /* High-voltage discharge time */
+    this->io->usleep(this->timing.tdis);    /* High-voltage discharge time */
     this->io->shift_bits_out(0x0000, 16);/* 16-bit payload (NOP) */
 }
 
+void Pic18::set_program_mode(void)
+{
+    if (!this->program_mode) {
+        this->tblptr_valid = false;
+        this->eeadr_valid  = false;
+    }
+    Pic::set_program_mode();
+}
+
+void Pic18::pic_off(void)
+{
+    Pic::pic_off();
+    if (!this->program_mode) {
+        this->tblptr_valid = false;
+        this->eeadr_valid  = false;
+    }
+}
+
+bool Pic18::keep_program_mode(void)
+{
+    return true;
+}
+
 void Pic18::set_tblptr(unsigned long addr)
 {
 uint32_t ins;
+unsigned long changed;
+
+    addr &= 0x3fffff;
+    changed = (this->tblptr_valid) ? (addr ^ this->tblptr) : 0x3fffff;
 
-    ins = ASM_MOVLW((addr >> 16) & 0x3f);   /* addr[21:16] */
-    write_command(COMMAND_CORE_INSTRUCTION, ins);
-    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TBLPTRU));
-    ins = ASM_MOVLW((addr >> 8) & 0xff);    /* addr[15:8] */
-    write_command(COMMAND_CORE_INSTRUCTION, ins);
-    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TBLPTRH));
-    ins = ASM_MOVLW(addr & 0xff);           /* addr[7:0] */
-    write_command(COMMAND_CORE_INSTRUCTION, ins);
-    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TBLPTRL));
+    if (changed & 0x3f0000) {
+        ins = ASM_MOVLW((addr >> 16) & 0x3f);   /* addr[21:16] */
+        write_command(COMMAND_CORE_INSTRUCTION, ins);
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TBLPTRU));
+    }
+    if (changed & 0x00ff00) {
+        ins = ASM_MOVLW((addr >> 8) & 0xff);    /* addr[15:8] */
+        write_command(COMMAND_CORE_INSTRUCTION, ins);
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TBLPTRH));
+    }
+    if (changed & 0x0000ff) {
+        ins = ASM_MOVLW(addr & 0xff);           /* addr[7:0] */
+        write_command(COMMAND_CORE_INSTRUCTION, ins);
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TBLPTRL));
+    }
+    this->tblptr = addr;
+    this->tblptr_valid = true;
+}
+
+void Pic18::set_eeadr(unsigned int addr)
+{
+unsigned int changed;
+
+    if (this->eeadr_valid && (addr == this->eeadr + 1)) {
+        /* Next address: increment, with the carry done by hand */
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_EEADR);
+        if (this->has_eeadrh && ((addr & 0xff) == 0)) {
+            write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_EEADRH);
+        }
+        this->eeadr = addr;
+        return;
+    }
+    changed = (this->eeadr_valid) ? (addr ^ this->eeadr) : 0xffff;
+
+    if (changed & 0x00ff) {
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(addr & 0xff));
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADR));
+    }
+    if (this->has_eeadrh && (changed & 0xff00)) {
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW((addr >> 8) & 0xff));
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADRH));
+    }
+    this->eeadr = addr;
+    this->eeadr_valid = true;
 }
 
 void Pic18::write_command(unsigned int command)
 {
     this->io->shift_bits_out(command, 4);
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly1);
 }
 
 void Pic18::write_command(unsigned int command, unsigned int data)
 {
     write_command(command);
     this->io->shift_bits_out(data, 16);
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly2);
+
+    /* Keep track of the changes to TBLPTR and EEADR */
+    switch (command) {
+        case COMMAND_CORE_INSTRUCTION:
+            if (data == ASM_INCF_TBLPTR) {
+                /* Only TBLPTRL is incremented, without carry */
+                this->tblptr = (this->tblptr & ~0xffUL) |
+                               ((this->tblptr + 1) & 0xff);
+            } else if ((data & 0xff00) == 0x6e00) {   /* movwf f,0 */
+                switch (data & 0xff) {
+                    case REG_TBLPTRU:
+                    case REG_TBLPTRH:
+                    case REG_TBLPTRL:
+                        this->tblptr_valid = false;
+                    break;
+                    case REG_EEADR:
+                    case REG_EEADRH:
+                        this->eeadr_valid = false;
+                    break;
+                }
+            }
+        break;
+        case COMMAND_TABLE_WRITE_POSTINC:
+            this->tblptr = (this->tblptr + 2) & 0x3fffff;
+        break;
+        case COMMAND_TABLE_WRITE_POSTDEC:
+            /* Post-increment with start on some devices: just forget it */
+            this->tblptr_valid = false;
+        break;
+    }
 }
 
 unsigned int Pic18::write_command_read_data(unsigned int command)
 {
     write_command(command);
     this->io->shift_bits_out(0x00, 8);      /* 8 dummy bits */
-    this->io->usleep(1);
+    this->io->usleep(this->timing.tdly2);
+
+    switch (command) {
+        case COMMAND_TABLE_READ_POSTINC:
+        case COMMAND_TABLE_READ_PREINC:
+            this->tblptr = (this->tblptr + 1) & 0x3fffff;
+        break;
+        case COMMAND_TABLE_READ_POSTDEC:
+            this->tblptr = (this->tblptr - 1) & 0x3fffff;
+        break;
+    }
     return (this->io->shift_bits_in(8) & 0xff);
 }
 
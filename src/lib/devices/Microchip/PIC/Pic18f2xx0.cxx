@@ -32,8 +32,9 @@ using namespace std;
 #define ID_LOC_WRDS    (8/2)
 #define CFG_WORDS_WRDS (14/2)
 
-Pic18f2xx0::Pic18f2xx0(char *name) : Pic18fxx20(name)
+Pic18f2xx0::Pic18f2xx0(const DeviceSpec *spec, char *name) : Pic18fxx20(spec, name)
 {
+    this->has_eeadrh = true;
 }
 
 Pic18f2xx0::~Pic18f2xx0()
@@ -63,11 +64,16 @@ void Pic18f2xx0::erase(void)
     }
 }
 
-void Pic18f2xx0::write_data_memory(DataBuffer& buf, unsigned long addr, bool verify)
-{
+void Pic18f2xx0::write_data_memory (
+    DataBuffer& buf,
+    unsigned long addr,
+    bool verify
+) {
     uint32_t        ins;
     uint8_t            data;
     unsigned int    offset = 0;    /* word offset    */
+    bool            same, skip;
+    IO::GangRead    mode;
 
     try {
         /* Step 1: Direct access to data EEPROM */
@@ -78,17 +84,25 @@ void Pic18f2xx0::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
             progress(addr+(2*offset));
 
             /* Step 2: Set the data EEPROM address pointer */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(offset));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADR));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(offset >> 8));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADRH));
-
-            if ((offset & 1) == 0) {
-                data = buf[(addr+offset)/2] & 0xff;
+            set_eeadr(offset);
+
+            data = get_ee_byte(buf, addr, offset);
+            if (this->can_skip_writes()) {
+                /* Read the cell first: if it already holds the data, it
+                 * isn't written again (and the read verifies it) */
+                same = (read_ee_byte() == data);
+                skip = same;
             } else {
-                data = (buf[(addr+offset)/2] >> 8) & 0xff;
+                /* The cells of all the targets can't be compared: skip
+                 * just the blank ones, the device has just been erased */
+                same = false;
+                skip = (data == 0xff);
             }
-            if (data != 0xff) {
+            if (skip) {
+                this->cells_skipped++;
+            } else {
+                this->cells_written++;
+
                 /* Step 3: Load the data to be written */
                 write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(data));
                 write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEDATA));
@@ -99,16 +113,19 @@ void Pic18f2xx0::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
                 /* Step 5: Initiate write */
                 write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_WR);
     
-                /* Step 6: Poll WR bit, repeat until the bit is clear */
+                /* Step 6: Poll WR bit, repeat until the bit is clear on
+                 * all the bit-parallel targets */
+                mode = this->gang_read(IO::GANG_READ_ANY);
                 do {
                     write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EECON1_W_0);
                     write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
                     write_command(COMMAND_CORE_INSTRUCTION, ASM_NOP);
                     ins = write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
                 } while (ins & 0x02);
+                this->gang_read(mode);
 
                 /* Step 7: Hold PGC low for time P10 */
-                this->io->usleep(100);    /* High-voltage discharge time P10 */
+                this->io->usleep(this->timing.tdis);
                 
                 /* Step 8: Disable writes */
                 write_command(COMMAND_CORE_INSTRUCTION, ASM_BCF_EECON1_WREN);
@@ -117,17 +134,7 @@ void Pic18f2xx0::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
             this->progress_count++;
 
             if (verify) {
-                /* Initiate a memory read */
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
-
-                /* Load data into the serial data holding register */
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EEDATA_W_0);
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_NOP);
-
-                /* Shift out data and check */
-                ins = write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
-                if (ins != data) {
+                if (!same && (read_ee_byte() != data)) {
                     throw runtime_error("");
                 }
                 this->progress_count++;
@@ -145,7 +152,6 @@ void Pic18f2xx0::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
 
 void Pic18f2xx0::read_data_memory(DataBuffer& buf, unsigned long addr, bool verify)
 {
-    uint32_t     ins;
     unsigned int offset;    /* Byte offset */
     unsigned int data;
 
@@ -159,11 +165,17 @@ void Pic18f2xx0::read_data_memory(DataBuffer& buf, unsigned long addr, bool veri
             /* Give byte addresses to progress() to match datasheet. */
             progress(addr+offset);
 
+            if (
+                verify && this->sparse_verify &&
+                (get_ee_byte(buf, addr, offset) == 0xff)
+            ) {
+                /* Blank byte: set_eeadr() jumps past it */
+                this->progress_count++;
+                continue;
+            }
+
             /* Set the data EEPROM address pointer */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(offset));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADR));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(offset >> 8));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADRH));
+            set_eeadr(offset);
 
             /* Initiate a memory read */
             write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
@@ -178,10 +190,26 @@ void Pic18f2xx0::read_data_memory(DataBuffer& buf, unsigned long addr, bool veri
             if (verify) {
                 /* The data is packed 2 bytes per word, little endian */
                 if ((offset & 1) == 0) {
-                    if (data != (buf[(addr + offset)/2] & 0xff))
+                    if (
+                        (data != (buf[(addr + offset)/2] & 0xff)) &&
+                        !this->mismatch (
+                            (addr + offset)/2,
+                            0x00ff,
+                            buf[(addr + offset)/2],
+                            data
+                        )
+                    )
                         throw runtime_error("");
                 } else {
-                    if (data != ((buf[(addr + offset)/2] >> 8) & 0xff))
+                    if (
+                        (data != ((buf[(addr + offset)/2] >> 8) & 0xff)) &&
+                        !this->mismatch (
+                            (addr + offset)/2,
+                            0xff00,
+                            buf[(addr + offset)/2],
+                            data << 8
+                        )
+                    )
                         throw runtime_error("");
                 }
             } else {
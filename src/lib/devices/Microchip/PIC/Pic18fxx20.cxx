@@ -33,8 +33,13 @@ using namespace std;
 #define ID_LOC_WRDS    (8/2)
 #define CFG_WORDS_WRDS (14/2)
 
-Pic18fxx20::Pic18fxx20(char *name) : Pic18(name)
+Pic18fxx20::Pic18fxx20(const DeviceSpec *spec, char *name) : Pic18(spec, name)
 {
+    /* Up to 256 bytes of data EEPROM, addressed by EEADR only */
+    this->has_eeadrh = false;
+
+    /* These parts spec a longer high voltage discharge time (P10) */
+    spec->get("tDIS",(int &)this->timing.tdis,100);
 }
 
 Pic18fxx20::~Pic18fxx20()
@@ -95,6 +100,44 @@ unsigned int offset;    /* byte offset */
     }
 }
 
+void Pic18fxx20::write_program_rows (
+    DataBuffer& buf,
+    unsigned long addr,
+    unsigned long len,
+    bool verify
+) {
+unsigned long offset;   /* byte offset */
+
+    offset = addr;
+    try {
+        /* Step 1: Direct access to code memory and enable writes */
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_EEPGD);
+        write_command(COMMAND_CORE_INSTRUCTION, ASM_BCF_EECON1_CFGS);
+
+        for (offset=addr; offset < (addr+len); offset+=write_buffer_size) {
+            /* Step 2: load table pointer with offset of current write block */
+            set_tblptr(offset);
+            /* Step 3,4: Load write buffer w/ wbuf_size bytes and start write */
+            if (load_write_buffer(buf, offset, write_buffer_size)) {
+                program_wait();
+            }
+            progress(offset);
+        }
+        if (verify) {
+            /* Verify the memory just written */
+            offset = addr;
+            read_memory(buf, addr, len/2, true);
+        }
+    } catch (std::exception& e) {
+        throw runtime_error (
+            (const char *)Preferences::Name(
+                "Couldn't write program memory at address 0x%06lx",
+                offset
+            )
+        );
+    }
+}
+
 void Pic18fxx20::write_id_memory(DataBuffer& buf, unsigned long addr, bool verify)
 {
     progress(addr);
@@ -124,11 +167,14 @@ void Pic18fxx20::write_id_memory(DataBuffer& buf, unsigned long addr, bool verif
     }
 }
 
-void Pic18fxx20::write_data_memory(DataBuffer& buf, unsigned long addr, bool verify)
-{
-    uint32_t     ins;
+void Pic18fxx20::write_data_memory (
+    DataBuffer& buf,
+    unsigned long addr,
+    bool verify
+) {
     uint8_t      data;
     unsigned int offset = 0;    /* word offset */
+    bool         same, skip;
 
     try {
         /* Step 1: Direct access to data EEPROM */
@@ -139,15 +185,25 @@ void Pic18fxx20::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
             progress(addr+(2*offset));
 
             /* Step 2: Set the data EEPROM address pointer */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(offset));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADR));
-
-            if ((offset & 1) == 0) {
-                data = buf[(addr+offset)/2] & 0xff;
+            set_eeadr(offset);
+
+            data = get_ee_byte(buf, addr, offset);
+            if (this->can_skip_writes()) {
+                /* Read the cell first: if it already holds the data, it
+                 * isn't written again (and the read verifies it) */
+                same = (read_ee_byte() == data);
+                skip = same;
             } else {
-                data = (buf[(addr+offset)/2] >> 8) & 0xff;
+                /* The cells of all the targets can't be compared: skip
+                 * just the blank ones, the device has just been erased */
+                same = false;
+                skip = (data == 0xff);
             }
-            if (data != 0xff) {
+            if (skip) {
+                this->cells_skipped++;
+            } else {
+                this->cells_written++;
+
                 /* Step 3: Load the data to be written */
                 write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(data));
                 write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEDATA));
@@ -170,7 +226,7 @@ void Pic18fxx20::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
                 this->io->usleep(this->erase_time);
                 
                 /* Then hold PGC low for time P10 */
-                this->io->usleep(5);    /* High-voltage discharge time P10 */
+                this->io->usleep(this->timing.tdis);
                 
                 /* Disable writes */
                 write_command(COMMAND_CORE_INSTRUCTION, ASM_BCF_EECON1_WREN);
@@ -179,17 +235,7 @@ void Pic18fxx20::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
             this->progress_count++;
 
             if (verify) {
-                /* Initiate a memory read */
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
-
-                /* Load data into the serial data holding register */
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EEDATA_W_0);
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
-                write_command(COMMAND_CORE_INSTRUCTION, ASM_NOP);
-
-                /* Shift out data and check */
-                ins = write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
-                if (ins != data) {
+                if (!same && (read_ee_byte() != data)) {
                     throw runtime_error("");
                 }
                 this->progress_count++;
@@ -205,10 +251,14 @@ void Pic18fxx20::write_data_memory(DataBuffer& buf, unsigned long addr, bool ver
     }
 }
 
-void Pic18fxx20::write_config_memory(DataBuffer& buf, unsigned long addr, bool verify)
-{
+void Pic18fxx20::write_config_memory (
+    DataBuffer& buf,
+    unsigned long addr,
+    bool verify
+) {
     int           i = 0;
     unsigned long skipd_addr;
+    unsigned int  changes;
 
     try {
         /* Step 1: Direct access to config memory */
@@ -227,14 +277,18 @@ void Pic18fxx20::write_config_memory(DataBuffer& buf, unsigned long addr, bool v
             progress(addr);
 
             /* Step 2: Set Table Pointer for config byte to be written. *
-             * Write even/odd addresses                                 */
+             * Write even/odd addresses, skipping the ones already set  */
+            changes = read_config_changes(buf, addr, config_masks[i]);
             set_tblptr(addr);
-            write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff);
-            program_wait();
-
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_TBLPTR);
-            write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff00);
-            program_wait();
+            if (changes & 0x00ff) {
+                write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff);
+                program_wait();
+            }
+            if (changes & 0xff00) {
+                write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_TBLPTR);
+                write_command(COMMAND_TABLE_WRITE_START, buf[(addr/2)] & 0xff00);
+                program_wait();
+            }
 
             this->progress_count++;
 
@@ -245,12 +299,18 @@ void Pic18fxx20::write_config_memory(DataBuffer& buf, unsigned long addr, bool v
         }
         /* Program word 6 last: if we protect the configuration words, */
         /* we won't be able to program word 7.                         */
+        i = 5;
+        changes = read_config_changes(buf, skipd_addr, config_masks[i]);
         set_tblptr(skipd_addr);
-        write_command(COMMAND_TABLE_WRITE_START, buf[(skipd_addr/2)] & 0xff);
-        program_wait();
-        write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_TBLPTR);
-        write_command(COMMAND_TABLE_WRITE_START, buf[(skipd_addr/2)] & 0xff00);
-        program_wait();
+        if (changes & 0x00ff) {
+            write_command(COMMAND_TABLE_WRITE_START, buf[(skipd_addr/2)] & 0xff);
+            program_wait();
+        }
+        if (changes & 0xff00) {
+            write_command(COMMAND_CORE_INSTRUCTION, ASM_INCF_TBLPTR);
+            write_command(COMMAND_TABLE_WRITE_START, buf[(skipd_addr/2)] & 0xff00);
+            program_wait();
+        }
 
         this->progress_count++;
         if (verify) {
@@ -269,7 +329,6 @@ void Pic18fxx20::write_config_memory(DataBuffer& buf, unsigned long addr, bool v
 
 void Pic18fxx20::read_data_memory(DataBuffer& buf, unsigned long addr, bool verify)
 {
-    uint32_t     ins;
     unsigned int offset; /* Byte offset */
     unsigned int data;
 
@@ -283,9 +342,17 @@ void Pic18fxx20::read_data_memory(DataBuffer& buf, unsigned long addr, bool veri
             /* Give byte addresses to progress() to match datasheet. */
             progress(addr+offset);
 
+            if (
+                verify && this->sparse_verify &&
+                (get_ee_byte(buf, addr, offset) == 0xff)
+            ) {
+                /* Blank byte: set_eeadr() jumps past it */
+                this->progress_count++;
+                continue;
+            }
+
             /* Set the data EEPROM address pointer */
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVLW(offset));
-            write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_EEADR));
+            set_eeadr(offset);
 
             /* Initiate a memory read */
             write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
@@ -300,11 +367,27 @@ void Pic18fxx20::read_data_memory(DataBuffer& buf, unsigned long addr, bool veri
             if (verify) {
                 /* The data is packed 2 bytes per word, little endian */
                 if ((offset & 1) == 0) {
-                    if (data != (buf[(addr + offset)/2] & 0xff)) {
+                    if (
+                        (data != (buf[(addr + offset)/2] & 0xff)) &&
+                        !this->mismatch (
+                            (addr + offset)/2,
+                            0x00ff,
+                            buf[(addr + offset)/2],
+                            data
+                        )
+                    ) {
                         throw runtime_error("");
                     }
                 } else {
-                    if (data != ((buf[(addr + offset)/2] >> 8) & 0xff)) {
+                    if (
+                        (data != ((buf[(addr + offset)/2] >> 8) & 0xff)) &&
+                        !this->mismatch (
+                            (addr + offset)/2,
+                            0xff00,
+                            buf[(addr + offset)/2],
+                            data << 8
+                        )
+                    ) {
                         throw runtime_error("");
                     }
                 }
@@ -332,6 +415,20 @@ void Pic18fxx20::read_data_memory(DataBuffer& buf, unsigned long addr, bool veri
     }
 }
 
+unsigned int Pic18fxx20::read_ee_byte(void)
+{
+    /* Initiate a memory read */
+    write_command(COMMAND_CORE_INSTRUCTION, ASM_BSF_EECON1_RD);
+
+    /* Load data into the serial data holding register */
+    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVF_EEDATA_W_0);
+    write_command(COMMAND_CORE_INSTRUCTION, ASM_MOVWF(REG_TABLAT));
+    write_command(COMMAND_CORE_INSTRUCTION, ASM_NOP);
+
+    /* Shift out data */
+    return write_command_read_data(COMMAND_SHIFT_OUT_TABLAT);
+}
+
 bool Pic18fxx20::load_write_buffer (
     DataBuffer&   buf,
     unsigned long addr,
@@ -365,6 +462,6 @@ void Pic18fxx20::program_wait(void)
     this->io->usleep(program_time);       /* P9                              */
 
     this->io->clock(false);
-    this->io->usleep(100);                /* High-voltage discharge time P10 */
+    this->io->usleep(this->timing.tdis);  /* High-voltage discharge P10 */
     this->io->shift_bits_out(0x0000, 16); /* 16-bit payload (NOP)            */
 }
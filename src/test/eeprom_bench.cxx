@@ -0,0 +1,165 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * PIC18 data EEPROM benchmark: programs and reads back a random data
+ * EEPROM image on a simulated target (see Sim18IO), checks the target
+ * and the data read, and prints the throughput of the data EEPROM
+ * algorithms: the bytes per second a real port would reach with the
+ * default signal delays, and the frames and bits clocked per byte. The
+ * write pass includes its verify.
+ *
+ * Usage: eeprom_bench <data directory>
+ *
+ * The data directory holds devices.prefs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+
+using namespace std;
+
+#include "Preferences.h"
+#include "DataBuffer.h"
+#include "Device.h"
+#include "Sim18IO.h"
+
+static const char *benchDevices[] = {
+    "Microchip/PIC/PIC18F452",      /* Pic18 */
+    "Microchip/PIC/PIC18F1220",     /* Pic18fxx20 */
+    "Microchip/PIC/PIC18F2520",     /* Pic18f2xx0 */
+    NULL
+};
+
+/* The data EEPROM area of the memory map, in DataBuffer words */
+static bool findEeprom(Device *chip, unsigned long& base, int& words)
+{
+IntPairVector mmap;
+
+    mmap = chip->get_mmap();
+    for (unsigned int i=0; i<mmap.size(); i++) {
+        if (mmap[i].first >= 0x780000 && mmap[i].first < 0x800000) {
+            base  = mmap[i].first;
+            words = mmap[i].second;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Prints the throughput of a pass over the data EEPROM */
+static void printPass(Sim18IO *sim, int bytes)
+{
+    printf (
+        " %9.0f %7lu %6lu",
+        (sim->get_time() > 0) ? bytes * 1e6 / sim->get_time() : 0.0,
+        sim->get_frames() / bytes,
+        sim->get_bits() / bytes
+    );
+}
+
+int main(int argc, char **argv)
+{
+char path[256];
+unsigned long base, addr;
+int words, bytes, errors, failed;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <data directory>\n", argv[0]);
+        return 2;
+    }
+
+    Preferences devices(argv[1], "flP5", "devices");
+
+    printf (
+        "%-24s %5s %9s %7s %6s %9s %7s %6s\n",
+        "",
+        "bytes",
+        "write B/s",
+        "frames",
+        "bits",
+        "read B/s",
+        "frames",
+        "bits"
+    );
+    failed = 0;
+    for (int i=0; benchDevices[i]; i++) {
+        Preferences device(devices, benchDevices[i]);
+        Device *chip = NULL;
+        Sim18IO *sim = NULL;
+
+        try {
+            strcpy(path, benchDevices[i]);
+            chip = Device::load(&device, path);
+            sim  = (Sim18IO *)IO::acquire(&devices, (char *)"Simulated18");
+            chip->set_iodevice(sim);
+            if (!findEeprom(chip, base, words)) {
+                throw runtime_error("No data EEPROM");
+            }
+            bytes = 2 * words;
+
+            /* Blank program and configuration memory, which the
+             * simulated target reads back, and a random data EEPROM */
+            DataBuffer buf(chip->get_wordsize());
+            DataBuffer readback(chip->get_wordsize());
+
+            srand(i + 1);
+            for (addr=base; addr<base+words; addr++) {
+                buf[addr] = rand() & 0xffff;
+            }
+
+            printf("%-24s %5d", benchDevices[i], bytes);
+            sim->reset_counters();
+            chip->program(buf);
+            printPass(sim, bytes);
+
+            sim->reset_counters();
+            chip->read(readback);
+            printPass(sim, bytes);
+            printf("\n");
+
+            errors = 0;
+            for (addr=base; addr<base+words; addr++) {
+                if (
+                    sim->get_byte(2*(addr-base))   != (buf[addr] & 0xff) ||
+                    sim->get_byte(2*(addr-base)+1) != (buf[addr] >> 8) ||
+                    (readback[addr] & 0xffff)      != buf[addr]
+                ) {
+                    errors++;
+                }
+            }
+            if (errors > 0) {
+                fprintf (
+                    stderr,
+                    "%s: %d data EEPROM words differ\n",
+                    benchDevices[i],
+                    errors
+                );
+                failed++;
+            }
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s: %s\n", benchDevices[i], e.what());
+            failed++;
+        }
+        delete chip;
+        delete sim;
+    }
+
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+/* Copyright (C) 2003-2010  Francesco Bradascio <fbradasc@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Gang programming stress test: programs several different devices at
+ * once, each on its own simulated target (see SimIO), and checks that
+ * every slot passed and that every target holds the image written.
+ *
+ * Usage: gang_stress <data directory> [rounds]
+ *
+ * The data directory holds devices.prefs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+
+using namespace std;
+
+#include "Preferences.h"
+#include "DataBuffer.h"
+#include "Device.h"
+#include "GangProgrammer.h"
+#include "SimIO.h"
+
+static const char *stressDevices[] = {
+    "Microchip/PIC/PIC16F84A",
+    "Microchip/PIC/PIC16F877A",
+    "Microchip/PIC/PIC16F628A",
+    "Microchip/PIC/PIC16F876",
+    "Microchip/PIC/PIC16F887",
+    "Microchip/PIC/PIC16F877",
+    NULL
+};
+
+/* Two slots per device, so that the slots programming the same device run
+ * side by side too */
+#define SLOTS_PER_DEVICE 2
+
+/* A random image: program memory, ID locations and data EEPROM. The
+ * configuration words are left blank, so that no code protection gets
+ * enabled. */
+static void fillImage(DataBuffer& buf)
+{
+unsigned long addr;
+
+    for (addr=0; addr<0x2000; addr++) {
+        buf[addr] = rand() & 0x3fff;
+    }
+    for (addr=0x2000; addr<0x2004; addr++) {
+        buf[addr] = rand() & 0x3fff;
+    }
+    buf[0x2007] = 0x3fff;
+    buf[0x2008] = 0x3fff;
+    for (addr=0x2100; addr<0x2200; addr++) {
+        buf[addr] = rand() & 0xff;
+    }
+}
+
+/* Compares the memory of the simulated target with the image, over the
+ * memory map of the device. Returns the number of mismatches. */
+static int checkTarget(Device *chip, SimIO *sim, DataBuffer& buf)
+{
+IntPairVector mmap;
+unsigned long addr, mask;
+int errors = 0;
+
+    mmap = chip->get_mmap();
+    for (unsigned int i=0; i<mmap.size(); i++) {
+        for (
+            addr = mmap[i].first;
+            addr < (unsigned long)(mmap[i].first + mmap[i].second);
+            addr++
+        ) {
+            /* The device ID is read only */
+            if (addr == 0x2005 || addr == 0x2006) {
+                continue;
+            }
+            mask = (addr >= 0x2100) ? 0xff : 0x3fff;
+            if ((sim->get_word(addr) & mask) != (buf[addr] & mask)) {
+                if (errors == 0) {
+                    fprintf (
+                        stderr,
+                        "%s: 0x%04lx is 0x%04x, expected 0x%04x\n",
+                        chip->get_name().c_str(),
+                        addr,
+                        sim->get_word(addr) & (unsigned int)mask,
+                        buf[addr] & (unsigned int)mask
+                    );
+                }
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+GangProgrammer gang;
+JobStepVector steps;
+char name[256];
+int rounds, failed;
+unsigned int slot, slots;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <data directory> [rounds]\n", argv[0]);
+        return 2;
+    }
+    rounds = (argc > 2) ? atoi(argv[2]) : 10;
+
+    Preferences devices(argv[1], "flP5", "devices");
+
+    try {
+        for (int i=0; stressDevices[i]; i++) {
+            Preferences device(devices, stressDevices[i]);
+
+            /* The same name for all the slots of a device, as the GUI
+             * does: add_slot() must not change it */
+            strcpy(name, stressDevices[i]);
+            for (int j=0; j<SLOTS_PER_DEVICE; j++) {
+                gang.add_slot (
+                    &devices,
+                    (char *)"Simulated",
+                    gang.get_slots(),
+                    &device,
+                    name
+                );
+            }
+        }
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    slots = gang.get_slots();
+
+    steps.push_back(JOB_ERASE);
+    steps.push_back(JOB_PROGRAM);
+    steps.push_back(JOB_VERIFY);
+
+    failed = 0;
+    for (int round=0; round<rounds; round++) {
+        DataBuffer buf(gang.get_device(0)->get_wordsize());
+
+        srand(round + 1);
+        fillImage(buf);
+        try {
+            gang.start(buf, steps);
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            gang.wait();
+            return 1;
+        }
+        gang.wait();
+
+        for (slot=0; slot<slots; slot++) {
+            Device *chip = gang.get_device(slot);
+
+            if (gang.get_state(slot) != SLOT_PASSED) {
+                fprintf (
+                    stderr,
+                    "round %d, slot %u, %s: %s\n",
+                    round,
+                    slot,
+                    chip->get_name().c_str(),
+                    gang.get_error(slot)
+                );
+                failed++;
+            } else if (
+                checkTarget(chip, (SimIO *)gang.get_io(slot), buf) != 0
+            ) {
+                failed++;
+            }
+        }
+    }
+    printf (
+        "%d rounds on %u slots: %d failures\n",
+        rounds,
+        slots,
+        failed
+    );
+
+    return (failed == 0) ? 0 : 1;
+}